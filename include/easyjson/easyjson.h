@@ -7,8 +7,16 @@
 #ifndef _EASYJSON_H
 #define _EASYJSON_H
 
+#include <span>
+#include <atomic>
+#include <memory>
+#include <vector>
 #include <optional>
+#include <cstdint>
+#include <type_traits>
 #include <fstream>
+#include <functional>
+#include <string_view>
 #include <initializer_list>
 
 #include "easyjson/internal/json_utilities.h"
@@ -23,6 +31,98 @@ namespace easyjson
 #define JSON_ARRAY json_array()
 
 class JsonImpl;
+class ParserContext;
+class JsonDocuments;
+
+//====================================================================
+
+/*
+ * Outcome of JsonObj::validate.
+ * */
+struct JsonValidation
+{
+	internal::ErrorCode m_errorCode{internal::ErrorCode::error0};
+	size_t m_position{0}; // offset of the byte where the error was found
+
+	bool isValid() const
+	{
+		return m_errorCode==internal::ErrorCode::error0;
+	}
+
+	const char* getErrorMsg() const
+	{
+		return internal::ErrorReporting::getErrorMsg(m_errorCode);
+	}
+};
+
+//====================================================================
+
+/*
+ * Memory taken by a document, or by the part of it under a JsonObj
+ * for the nodes (see JsonObj::memoryStats).
+ * */
+struct JsonDocumentStats
+{
+	size_t m_nodes{0};
+	size_t m_vectors{0}; // one per array, holding its items
+	size_t m_bufferBytes{0}; // the text of the whole document
+	size_t m_wastedBytes{0}; // of m_bufferBytes, reserved but not in use
+};
+
+//====================================================================
+
+/*
+ * Work done by JsonObj::parse on top of checking the syntax.
+ * */
+struct ParseOptions
+{
+	/*
+	 * Every number is converted once, to an int64_t when it is written
+	 * as an integer that fits in one and to the nearest double
+	 * otherwise, and kept in its node: getValue<T>() for an arithmetic
+	 * T (bool aside) loads it instead of reading the text again. The
+	 * text is kept for getRawData() and toString().
+	 * */
+	bool m_decodeNumbers{false};
+
+	/*
+	 * The input has to be valid UTF-8, it is checked while it is
+	 * indexed rather than in a pass of its own. The first invalid
+	 * sequence (overlong forms, surrogates and code points above
+	 * U+10FFFF included) is reported as error27 and getErrorPosition()
+	 * gives the offset of its first byte.
+	 * */
+	bool m_strictUTF8{false};
+
+	/*
+	 * Every distinct key is stored once and identified by an integer,
+	 * shared by all the keys with the same text: a duplicate is
+	 * spotted with one comparison of ids, the lookup of a key that is
+	 * not in the document stops at the symbol table and the keys added
+	 * to the document later on are not copied again when they are
+	 * there already. Objects still keep their keys in order.
+	 * */
+	bool m_internKeys{false};
+
+	/*
+	 * For input known to be well formed: the keys of an object are
+	 * appended as they come, neither sorted nor checked for duplicates,
+	 * and the object is indexed the first time a key is looked up,
+	 * added or removed. Then, of several keys with the same text, the
+	 * last one wins, the others are dropped. Until then toString()
+	 * gives the keys in the order of the document, duplicates included.
+	 * */
+	bool m_trustedInput{false};
+
+	/*
+	 * The nodes of the document come from pools of its own rather
+	 * than from the ones of the process, one after the other in the
+	 * order of the text, and are released with them: dropping the
+	 * document frees a handful of chunks without walking the tree.
+	 * Nodes freed by edits in between are reused by the document only.
+	 * */
+	bool m_arena{false};
+};
 
 //====================================================================
 
@@ -32,7 +132,89 @@ class JsonObj
 		~JsonObj();
 		
 		static JsonObj parse(const char* str, ErrorHandlerMode mode=ErrorHandlerMode::Exception);
-		
+
+		/*
+		 * The input does not need to be NUL terminated, the parser
+		 * stops at length. The data is copied once. Any input of 2GiB
+		 * (2^31 bytes) or more, whatever the function that parses or
+		 * validates it, is rejected with error28 before it is read.
+		 * */
+		static JsonObj parse(const char* str, size_t length, ErrorHandlerMode mode=ErrorHandlerMode::Exception);
+
+		static JsonObj parse(std::string_view str, ErrorHandlerMode mode=ErrorHandlerMode::Exception)
+		{
+			return parse(str.data(), str.size(), mode);
+		}
+
+		static JsonObj parse(const char* str, size_t length, const ParseOptions& options, ErrorHandlerMode mode=ErrorHandlerMode::Exception);
+
+		static JsonObj parse(std::string_view str, const ParseOptions& options, ErrorHandlerMode mode=ErrorHandlerMode::Exception)
+		{
+			return parse(str.data(), str.size(), options, mode);
+		}
+
+		/*
+		 * For a document that is one large array: its items are split
+		 * among up to threadCount threads (at least 1MB of input each).
+		 * Any other document is parsed by the calling thread alone.
+		 * */
+		static JsonObj parse(const char* str, size_t length, unsigned threadCount, ErrorHandlerMode mode=ErrorHandlerMode::Exception);
+
+		/*
+		 * No copy: the document is built in buffer, which is modified
+		 * by the parser and has to outlive the returned object. The
+		 * document makes its own copy only if an edit needs more room.
+		 * */
+		static JsonObj parseInSitu(char* buffer, size_t length, ErrorHandlerMode mode=ErrorHandlerMode::Exception);
+
+		/*
+		 * Checked as parse would do it, but only the top level is
+		 * built. An object or array nested in it is parsed (one level
+		 * again) the first time operator[] or follow() reaches it, and
+		 * toString() copies the ones never reached as they were written.
+		 * A document that is read from should not be shared between
+		 * threads, even through const references.
+		 * */
+		static JsonObj parseLazy(const char* str, size_t length, ErrorHandlerMode mode=ErrorHandlerMode::Exception);
+
+		static JsonObj parseLazy(std::string_view str, ErrorHandlerMode mode=ErrorHandlerMode::Exception)
+		{
+			return parseLazy(str.data(), str.size(), mode);
+		}
+
+		/*
+		 * Only the values found on paths (as in follow(), '*' standing
+		 * for any key or index) are built, with the objects and arrays
+		 * that lead to them: an array keeps the items that are selected,
+		 * in order, so their indices may change. Whatever is left out is
+		 * skipped without allocating, only its brackets and quotes are
+		 * matched, and duplicate keys are only found among the keys kept.
+		 * */
+		static JsonObj parseProjected(const char* str, size_t length, std::span<const std::string_view> paths, ErrorHandlerMode mode=ErrorHandlerMode::Exception);
+
+		static JsonObj parseProjected(std::string_view str, std::initializer_list<std::string_view> paths, ErrorHandlerMode mode=ErrorHandlerMode::Exception)
+		{
+			return parseProjected(str.data(), str.size(), std::span<const std::string_view>(paths.begin(), paths.size()), mode);
+		}
+
+		/*
+		 * Syntax check only, as JsonObj::parse would do it (duplicate
+		 * keys included unless checkDuplicateKeys is false) but with no
+		 * document. str is not modified and nothing is allocated unless
+		 * the objects open at a time hold hundreds of keys or are nested
+		 * more than 1024 levels. Never throws.
+		 * */
+		static JsonValidation validate(std::string_view str, bool checkDuplicateKeys=true);
+
+		/*
+		 * Independent documents spread over threadCount threads, each
+		 * with pools of its own, that take them in order and steal from
+		 * each other when they run out. A document that fails to parse
+		 * does not stop the others, it keeps its error whatever the mode
+		 * (which applies to what is done with it afterwards).
+		 * */
+		static JsonDocuments parseMany(std::span<const std::string_view> documents, unsigned threadCount, ErrorHandlerMode mode=ErrorHandlerMode::Exception);
+
 		static JsonObj initObj(ErrorHandlerMode mode=ErrorHandlerMode::Exception);
 		
 		static JsonObj parse(const char8_t* str, ErrorHandlerMode mode=ErrorHandlerMode::Exception)
@@ -40,14 +222,42 @@ class JsonObj
 			return parse(reinterpret_cast<const char*>(str), mode);
 		}
 
+		/*
+		 * The file is mapped and parsed in place. A file of 2GiB or
+		 * more, too large to be indexed, fails with error28 before it
+		 * is mapped or read (see parse).
+		 * */
 		static JsonObj parseJsonFile(const char* jsonFileName, ErrorHandlerMode mode=ErrorHandlerMode::Exception);
+
+		// as parse(str, length, threadCount, mode)
+		static JsonObj parseJsonFile(const char* jsonFileName, unsigned threadCount, ErrorHandlerMode mode=ErrorHandlerMode::Exception);
 		
+		/*
+		 * \uXXXX sequences of cstr as UTF-8. Strings read from a parsed
+		 * document are decoded already (escape sequences included).
+		 * */
 		static std::string utf8Encode(const char* cstr);
 
 		bool isValid() const;
 
 		std::string getErrorMsg() const;
 
+		static constexpr size_t npos=internal::ErrorReporting::c_NO_POSITION;
+
+		/*
+		 * Offset in the input of the byte where parsing failed, as
+		 * JsonValidation::m_position: the end of the input, whitespace
+		 * aside, when the document is incomplete. npos for the errors
+		 * that are not in the text (i.e. a file that cannot be opened,
+		 * a key not found) and when the document is valid.
+		 * */
+		size_t getErrorPosition() const;
+
+		/*
+		 * key is matched against the decoded keys of the document, as
+		 * UTF-8; a key holding U+0000 is written with C0 80 there (see
+		 * getRawData).
+		 * */
 		bool hasKey(const char* key) const;
 
 		const JsonObj operator[](const char* key) const;// __attribute__((always_inline)) __attribute__((hot));
@@ -98,11 +308,30 @@ class JsonObj
 		//for obj
 		void append(easyjson::JsonPair&& data);
 
+		/*
+		 * The text as it is stored: strings are decoded, with U+0000 as
+		 * C0 80 so that they stay NUL terminated and a lone surrogate
+		 * as its 3 bytes, ED A0 to ED BF. getValue<std::string>() gives
+		 * U+0000 back as '\0', toString() writes both as \uXXXX.
+		 * */
 		const char* getRawData() const;
 
 		template<typename T>
 		std::optional<T> getValue() const
 		{
+			if constexpr(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>){
+				int64_t integer;
+				double real;
+				switch(getDecoded(integer, real)){
+					case JSON_TYPES::_INT:
+						return static_cast<T>(integer);
+					case JSON_TYPES::_DOUBLE:
+						return static_cast<T>(real);
+					default:
+						break;
+				}
+			}
+
 			const char* data=getRawData();
 			if(!data){
 				return std::nullopt;
@@ -136,6 +365,8 @@ class JsonObj
 		bool isNumeric() const;
 
 		size_t size() const;
+
+		JsonDocumentStats memoryStats() const;
 		
 		std::string toString(bool prettyStr=false) const;
 
@@ -143,6 +374,12 @@ class JsonObj
 		
 		JsonImpl* m_impl{nullptr};
 
+		/*
+		 * _INT (integer set) or _DOUBLE (real set) if the value is a
+		 * number decoded by the parser, _NA otherwise.
+		 * */
+		JSON_TYPES getDecoded(int64_t& integer, double& real) const;
+
 		JsonObj(JsonObj&& other) __attribute__((always_inline))
 		: m_impl(other.m_impl)
 		{
@@ -156,6 +393,236 @@ class JsonObj
 
 		JsonObj(const JsonObj& other)=delete;
 		JsonObj& operator=(const JsonObj&)=delete;
+
+	friend class JsonStreamParser;
+	friend class JsonReusableParser;
+	friend class JsonLinesReader;
+	friend class JsonDocuments;
+};
+
+//====================================================================
+
+/*
+ * Outcome of JsonObj::parseMany, in the order of the input.
+ * */
+class JsonDocuments
+{
+	public:
+		~JsonDocuments()=default;
+
+		JsonDocuments(JsonDocuments&&)=default;
+
+		size_t size() const
+		{
+			return m_documents.size();
+		}
+
+		// check isValid() for the outcome of its parsing
+		JsonObj& operator[](size_t idx)
+		{
+			return *m_documents[idx];
+		}
+
+		const JsonObj& operator[](size_t idx) const
+		{
+			return *m_documents[idx];
+		}
+
+		// number of documents that could not be parsed
+		size_t errorCount() const;
+
+	private:
+		std::vector<std::unique_ptr<JsonObj>> m_documents;
+
+		explicit JsonDocuments(const std::vector<JsonImpl*>& impls);
+
+		JsonDocuments(const JsonDocuments&)=delete;
+		JsonDocuments& operator=(const JsonDocuments&)=delete;
+
+	friend class JsonObj;
+};
+
+//====================================================================
+
+/*
+ * For a document that arrives in chunks (i.e. from a socket): each
+ * chunk is parsed as soon as it is fed, only the token cut at its end
+ * waits for the next one.
+ * */
+class JsonStreamParser
+{
+	public:
+		explicit JsonStreamParser(ErrorHandlerMode mode=ErrorHandlerMode::Exception);
+
+		~JsonStreamParser();
+
+		// false as soon as the input is known to be invalid
+		bool feed(const char* chunk, size_t length);
+
+		bool feed(std::string_view chunk)
+		{
+			return feed(chunk.data(), chunk.size());
+		}
+
+		/*
+		 * End of the input. The parser is ready for a new document
+		 * afterwards.
+		 * */
+		JsonObj finish();
+
+		bool isValid() const;
+
+		std::string getErrorMsg() const;
+
+	private:
+		JsonImpl* m_impl{nullptr};
+		ParserContext* m_context{nullptr};
+		ErrorHandlerMode m_mode;
+
+		void reset();
+
+		JsonStreamParser(const JsonStreamParser&)=delete;
+		JsonStreamParser& operator=(const JsonStreamParser&)=delete;
+};
+
+//====================================================================
+
+/*
+ * For many documents parsed one after the other by the same thread
+ * (i.e. the bodies of requests). Every parse reuses the document of
+ * the previous one, whose buffer keeps its capacity and whose nodes go
+ * back to the pools to be taken again straight away, and the parser
+ * state (container stack, structural index) is reset instead of being
+ * made again. Once warmed up, parsing a document of a similar size
+ * does not allocate (but for arrays of more than 256 items, whose
+ * storage is too large for the pools).
+ * */
+class JsonReusableParser
+{
+	public:
+		explicit JsonReusableParser(const ParseOptions& options=ParseOptions(), ErrorHandlerMode mode=ErrorHandlerMode::Exception);
+
+		~JsonReusableParser();
+
+		// valid until the next call to parse(), check isValid() on it
+		JsonObj& parse(const char* str, size_t length);
+
+		JsonObj& parse(std::string_view str)
+		{
+			return parse(str.data(), str.size());
+		}
+
+		JsonObj& document()
+		{
+			return m_document;
+		}
+
+	private:
+		JsonObj m_document;
+		ParserContext* m_context;
+		ParseOptions m_options;
+
+		JsonReusableParser(const JsonReusableParser&)=delete;
+		JsonReusableParser& operator=(const JsonReusableParser&)=delete;
+};
+
+//====================================================================
+
+/*
+ * JSON Lines (NDJSON) file, one document per line. The file is mapped
+ * once, read only, and every line is parsed into a document that is
+ * reused from one line to the next: its buffer keeps its capacity and
+ * the nodes of the previous line go back to the pools.
+ * */
+class JsonLinesReader
+{
+	public:
+		explicit JsonLinesReader(const char* jsonFileName, ErrorHandlerMode mode=ErrorHandlerMode::Exception);
+
+		~JsonLinesReader();
+
+		// false if the file could not be read
+		bool isValid() const;
+
+		std::string getErrorMsg() const;
+
+		/*
+		 * Parses the next non empty line into document(), false at
+		 * the end of the file.
+		 * */
+		bool next();
+
+		// valid until the next call to next()
+		JsonObj& document()
+		{
+			return m_document;
+		}
+
+		// of the line in document(), starting at 1
+		size_t lineNumber() const
+		{
+			return m_lineNumber;
+		}
+
+		/*
+		 * Calls cbk(obj, lineNumber) for every remaining non empty line.
+		 * With threadCount>1 the lines are split among that many threads
+		 * and cbk is called concurrently from them; obj must not be kept
+		 * after cbk returns.
+		 * */
+		void forEach(const std::function<void(JsonObj&, size_t)>& cbk, unsigned threadCount=1);
+
+	private:
+		JsonImpl* m_file;
+		JsonObj m_document;
+		ErrorHandlerMode m_mode;
+		size_t m_length{0};
+		size_t m_position{0};
+		size_t m_lineNumber{0};
+
+		size_t parseRange(size_t first, size_t last, size_t lineNumber, const std::function<void(JsonObj&, size_t)>& cbk, const std::atomic<bool>& stop) const;
+
+		JsonLinesReader(const JsonLinesReader&)=delete;
+		JsonLinesReader& operator=(const JsonLinesReader&)=delete;
+};
+
+//====================================================================
+
+// one size class of JsonMemory::poolStats
+struct JsonPoolStats
+{
+	size_t m_blockSize{0};
+	size_t m_liveBlocks{0};
+	size_t m_freeBlocks{0}; // length of the free list
+	size_t m_chunks{0};
+	size_t m_peakChunks{0}; // the most chunks held at one time
+};
+
+//====================================================================
+
+/*
+ * The pools the documents are allocated from. What a document frees
+ * stays in the pools of the thread that allocated it, to be reused;
+ * only chunks none of whose blocks is in use can be given back.
+ * */
+class JsonMemory
+{
+	public:
+		// releases the fully free chunks, returns the bytes released
+		static size_t trim();
+
+		/*
+		 * Once the pools of a thread hold more than bytes, releasing a
+		 * document trims them. Zero (the default) turns it off.
+		 * */
+		static void setHighWatermark(size_t bytes);
+
+		/*
+		 * By size class, the pools of the calling thread added to the
+		 * ones left by the threads that exited. The lists are walked,
+		 * meant for metrics, not for hot paths.
+		 * */
+		static std::vector<JsonPoolStats> poolStats();
 };
 
 template<>
@@ -0,0 +1,124 @@
+/*********************************************************************
+* class JsonSax                                       					*
+*                                                                    *
+* Date:    17-10-2026                                                *
+* Author:  Dan Machado                                               *                                         *
+**********************************************************************/
+#ifndef _EASYJSON_SAX_H
+#define _EASYJSON_SAX_H
+
+#include <string>
+#include <string_view>
+
+#include "easyjson/internal/json_utilities.h"
+#include "easyjson/internal/event_parser.h"
+
+//====================================================================
+
+namespace easyjson
+{
+
+/*
+ * Does nothing, a handler can derive from it and define only the
+ * events it is interested in.
+ * */
+struct JsonSaxHandler
+{
+	void startObject(){}
+	void endObject(){}
+	void startArray(){}
+	void endArray(){}
+	void key(std::string_view){}
+	void string(std::string_view){}
+	void number(std::string_view){}
+	void boolean(bool){}
+	void null(){}
+};
+
+//====================================================================
+
+/*
+ * Event parser: the input goes through the same structural index and
+ * syntax rules as JsonObj::parse but no node is allocated, the events
+ * are passed to the handler as they are found. The handler is a
+ * template parameter so the calls can be inlined.
+ *
+ * Keys and strings are views into the input, without the quotes. The
+ * escape sequences are validated but not decoded. Numbers are passed
+ * as written. Duplicate keys are reported as JsonObj::parse reports
+ * them, unless checkDuplicateKeys is false (see JsonObj::validate).
+ *
+ * The input is never modified and does not need to be NUL terminated.
+ * The same instance can parse any number of documents.
+ * */
+class JsonSax
+{
+	public:
+		explicit JsonSax(ErrorHandlerMode mode=ErrorHandlerMode::Exception)
+		: m_errorHandler(mode)
+		{
+		}
+
+		~JsonSax()=default;
+
+		template<typename Handler>
+		bool parse(const char* str, size_t length, Handler& handler, bool checkDuplicateKeys=true);
+
+		template<typename Handler>
+		bool parse(std::string_view str, Handler& handler, bool checkDuplicateKeys=true)
+		{
+			return parse(str.data(), str.size(), handler, checkDuplicateKeys);
+		}
+
+		bool isValid() const
+		{
+			return m_errorHandler.isValid();
+		}
+
+		std::string getErrorMsg() const
+		{
+			return m_errorHandler.getErrorMsg();
+		}
+
+		// offset in the input of the byte where the last error was found
+		size_t getErrorPosition() const
+		{
+			return m_errorPosition;
+		}
+
+	private:
+		internal::ErrorReporting m_errorHandler;
+		internal::ScopeStack m_scopes;
+		size_t m_errorPosition{0};
+
+		JsonSax(const JsonSax&)=delete;
+		JsonSax& operator=(const JsonSax&)=delete;
+};
+
+//--------------------------------------------------------------------
+
+template<typename Handler>
+bool JsonSax::parse(const char* str, size_t length, Handler& handler, bool checkDuplicateKeys)
+{
+	m_errorHandler.reset();
+
+	internal::ErrorCode errorCode;
+	if(checkDuplicateKeys){
+		internal::KeySet keys(str);
+		errorCode=internal::parseEvents(str, length, handler, m_scopes, &keys, m_errorPosition);
+	}
+	else{
+		errorCode=internal::parseEvents(str, length, handler, m_scopes, nullptr, m_errorPosition);
+	}
+	if(errorCode!=internal::ErrorCode::error0){
+		m_errorHandler.setError(errorCode);
+	}
+
+	return m_errorHandler.isValid();
+}
+
+//====================================================================
+
+}// easyjson namespace
+
+#endif
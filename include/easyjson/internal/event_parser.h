@@ -0,0 +1,756 @@
+/*********************************************************************
+* ScopeStack class                             								*
+* KeySet class                                                       *
+* ScopeMap class                                                     *
+* parseEvents                                                        *
+*                                                                    *
+* Version: 1.0                                                       *
+* Date:    17-10-2026                                                *
+* Author:  Dan Machado                                               *                                         *
+**********************************************************************/
+#ifndef EVENT_PARSER_H
+#define EVENT_PARSER_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <string_view>
+
+#include "easyjson/internal/json_utilities.h"
+#include "easyjson/internal/structural_index.h"
+#include "easyjson/internal/syntax_rules.h"
+
+//====================================================================
+
+namespace easyjson
+{
+namespace internal
+{
+
+/*
+ * Array that lives inside its owner until it needs more than N items,
+ * it only goes to the heap after that.
+ * */
+template<typename T, size_t N>
+class SmallBuffer
+{
+	public:
+		SmallBuffer()=default;
+
+		~SmallBuffer()
+		{
+			if(m_data!=m_inline){
+				delete[] m_data;
+			}
+		}
+
+		T& operator[](size_t idx) __attribute__((always_inline))
+		{
+			return m_data[idx];
+		}
+
+		const T& operator[](size_t idx) const __attribute__((always_inline))
+		{
+			return m_data[idx];
+		}
+
+		size_t capacity() const
+		{
+			return m_capacity;
+		}
+
+		// the first count items are kept
+		void grow(size_t capacity, size_t count)
+		{
+			T* data=new T[capacity];
+			std::memcpy(data, m_data, count*sizeof(T));
+
+			if(m_data!=m_inline){
+				delete[] m_data;
+			}
+
+			m_data=data;
+			m_capacity=capacity;
+		}
+
+	private:
+		T m_inline[N];
+		T* m_data{m_inline};
+		size_t m_capacity{N};
+
+		SmallBuffer(const SmallBuffer&)=delete;
+		SmallBuffer& operator=(const SmallBuffer&)=delete;
+};
+
+//====================================================================
+
+/*
+ * Open objects and arrays, one bit each (1 for objects).
+ * */
+class ScopeStack
+{
+	public:
+		void clear()
+		{
+			m_depth=0;
+		}
+
+		bool empty() const
+		{
+			return m_depth==0;
+		}
+
+		void push(bool isObj) __attribute__((always_inline))
+		{
+			const size_t word=m_depth/64;
+			if(word==m_bits.capacity()){
+				m_bits.grow(2*m_bits.capacity(), word);
+			}
+
+			const uint64_t bit=uint64_t(1)<<(m_depth%64);
+			if(isObj){
+				m_bits[word]|=bit;
+			}
+			else{
+				m_bits[word]&=~bit;
+			}
+			m_depth++;
+		}
+
+		void pop() __attribute__((always_inline))
+		{
+			m_depth--;
+		}
+
+		bool isObj() __attribute__((always_inline))
+		{
+			return (m_bits[(m_depth-1)/64]>>((m_depth-1)%64)) & 1;
+		}
+
+	private:
+		SmallBuffer<uint64_t, 16> m_bits; // 1024 levels before touching the heap
+		size_t m_depth{0};
+};
+
+//====================================================================
+
+/*
+ * Keys of the objects that are still open, to detect duplicates with
+ * no tree. Keys are compared decoded, the way the document parser
+ * compares them: "a\/b" and "a/b" are the same key.
+ *
+ * A key is stored as its offset and length in the input, or in
+ * m_decoded when it holds an escape sequence. The keys are
+ * stacked in order, so the keys of the innermost open object are the
+ * last ones. A new key is compared with them one by one, until the
+ * object holds more than c_LINEAR keys: from then on they also go in
+ * an open addressing table, tagged with their object, and are removed
+ * from it when the object closes.
+ * */
+class KeySet
+{
+	public:
+		explicit KeySet(const char* buffer)
+		: m_buffer(buffer)
+		{
+		}
+
+		void openScope()
+		{
+			pushOrder({c_SCOPE, uint32_t(m_scopeStart), uint32_t(m_decodedCount<<1 | m_hashed)});
+			m_scopeStart=m_orderCount;
+			m_hashed=false;
+		}
+
+		void closeScope()
+		{
+			if(m_hashed){
+				for(size_t i=m_scopeStart; i<m_orderCount; i++){
+					erase(m_order[i]);
+				}
+			}
+
+			m_orderCount=m_scopeStart-1;
+			m_scopeStart=m_order[m_orderCount].m_scope;
+			m_hashed=m_order[m_orderCount].m_hash & 1;
+			m_decodedCount=m_order[m_orderCount].m_hash>>1;
+		}
+
+		/*
+		 * False if the object already has the key. escaped tells that
+		 * the key holds escape sequences, they have been checked.
+		 * */
+		bool insert(size_t offset, size_t length, bool escaped=false)
+		{
+			Entry entry{(uint64_t(offset)<<32) | length, uint32_t(m_scopeStart), 0};
+			if(escaped){
+				if(m_decodedCount+length>m_decoded.capacity()){
+					m_decoded.grow(std::max(2*m_decoded.capacity(), m_decodedCount+length), m_decodedCount);
+				}
+				length=decodeEscapes(m_buffer+offset, length, &m_decoded[m_decodedCount]);
+				entry.m_key=(uint64_t(m_decodedCount)<<32) | c_DECODED | length;
+			}
+
+			if(!m_hashed){
+				for(size_t i=m_scopeStart; i<m_orderCount; i++){
+					if((m_order[i].m_key & c_LENGTH)==length && view(m_order[i])==view(entry)){
+						return false;
+					}
+				}
+
+				if(m_orderCount-m_scopeStart==c_LINEAR){
+					for(size_t i=m_scopeStart; i<m_orderCount; i++){
+						m_order[i].m_hash=hash(m_order[i]);
+						add(m_order[i]);
+					}
+					m_hashed=true;
+				}
+			}
+
+			if(m_hashed){
+				entry.m_hash=hash(entry);
+
+				size_t idx=find(entry);
+				if(m_slots[idx].m_key!=0){
+					return false;
+				}
+				add(entry);
+			}
+
+			pushOrder(entry);
+			if(escaped){
+				m_decodedCount+=length;
+			}
+
+			return true;
+		}
+
+	private:
+		struct Entry
+		{
+			uint64_t m_key; // offset and length, 0 for an empty slot
+			uint32_t m_scope; // where the keys of its object start in m_order
+			uint32_t m_hash; // for c_SCOPE, m_decodedCount and m_hashed of the object outside
+		};
+
+		static constexpr uint64_t c_SCOPE=uint64_t(-1);
+		static constexpr uint64_t c_DECODED=uint64_t(1)<<31; // the offset is in m_decoded, see c_MAX_LENGTH
+		static constexpr uint64_t c_LENGTH=c_DECODED-1;
+		static constexpr size_t c_LINEAR=32;
+		static constexpr size_t c_SLOTS=512; // a power of 2
+
+		const char* m_buffer;
+		SmallBuffer<Entry, c_SLOTS> m_slots;
+		SmallBuffer<Entry, c_SLOTS> m_order;
+		SmallBuffer<char, 256> m_decoded; // the keys with escape sequences, decoded
+		size_t m_decodedCount{0};
+		size_t m_slotCount{0};
+		size_t m_orderCount{0};
+		size_t m_scopeStart{0};
+		bool m_hashed{false};
+		bool m_tableReady{false};
+
+		std::string_view view(const Entry& entry) const __attribute__((always_inline))
+		{
+			const char* base=(entry.m_key & c_DECODED)? &m_decoded[0] : m_buffer;
+			return std::string_view(base+(entry.m_key>>32), entry.m_key & c_LENGTH);
+		}
+
+		uint32_t hash(const Entry& entry) const
+		{
+			std::string_view key=view(entry);
+			const char* p=key.data();
+			size_t length=key.size();
+
+			uint64_t h=(entry.m_scope+length)*0x9e3779b97f4a7c15ULL;
+			while(length>=8){
+				uint64_t word;
+				std::memcpy(&word, p, 8);
+				h=(h^word)*0x9e3779b97f4a7c15ULL;
+				h^=h>>32;
+				p+=8;
+				length-=8;
+			}
+
+			if(length>0){
+				uint64_t word=0;
+				std::memcpy(&word, p, length);
+				h=(h^word)*0x9e3779b97f4a7c15ULL;
+				h^=h>>32;
+			}
+
+			return h;
+		}
+
+		// slot holding an equal key or the empty slot where it would go
+		size_t find(const Entry& entry) const
+		{
+			const size_t mask=m_slots.capacity()-1;
+			size_t idx=entry.m_hash & mask;
+			while(m_slots[idx].m_key!=0){
+				const Entry& slot=m_slots[idx];
+				if(slot.m_hash==entry.m_hash && slot.m_scope==entry.m_scope && view(slot)==view(entry)){
+					break;
+				}
+				idx=(idx+1) & mask;
+			}
+			return idx;
+		}
+
+		void add(const Entry& entry)
+		{
+			if(!m_tableReady){
+				std::memset(&m_slots[0], 0, m_slots.capacity()*sizeof(Entry));
+				m_tableReady=true;
+			}
+
+			if(2*(m_slotCount+1)>m_slots.capacity()){
+				rehash(2*m_slots.capacity());
+			}
+
+			m_slots[find(entry)]=entry;
+			m_slotCount++;
+		}
+
+		// backward shift, no tombstones
+		void erase(const Entry& entry)
+		{
+			const size_t mask=m_slots.capacity()-1;
+			size_t idx=find(entry);
+			m_slots[idx].m_key=0;
+			m_slotCount--;
+
+			size_t next=(idx+1) & mask;
+			while(m_slots[next].m_key!=0){
+				size_t home=m_slots[next].m_hash & mask;
+				if(((next-home) & mask)>=((next-idx) & mask)){
+					m_slots[idx]=m_slots[next];
+					m_slots[next].m_key=0;
+					idx=next;
+				}
+				next=(next+1) & mask;
+			}
+		}
+
+		void rehash(size_t capacity)
+		{
+			const size_t oldCapacity=m_slots.capacity();
+			Entry* old=new Entry[oldCapacity];
+			std::memcpy(old, &m_slots[0], oldCapacity*sizeof(Entry));
+
+			m_slots.grow(capacity, 0);
+			std::memset(&m_slots[0], 0, capacity*sizeof(Entry));
+
+			for(size_t i=0; i<oldCapacity; i++){
+				if(old[i].m_key!=0){
+					m_slots[find(old[i])]=old[i];
+				}
+			}
+			delete[] old;
+		}
+
+		void pushOrder(const Entry& entry) __attribute__((always_inline))
+		{
+			if(m_orderCount==m_order.capacity()){
+				m_order.grow(2*m_order.capacity(), m_orderCount);
+			}
+			m_order[m_orderCount++]=entry;
+		}
+
+		KeySet(const KeySet&)=delete;
+		KeySet& operator=(const KeySet&)=delete;
+};
+
+//====================================================================
+
+/*
+ * Where every object and array of a document ends, in the order they
+ * start. JsonObj::parseLazy leaves the containers unparsed until they
+ * are accessed and jumps over the ones nested in the scope it parses.
+ * */
+class ScopeMap
+{
+	public:
+		ScopeMap()=default;
+		~ScopeMap()=default;
+
+		void openScope(size_t position) __attribute__((always_inline))
+		{
+			m_open.push_back(m_scopes.size());
+			m_scopes.push_back({uint32_t(position), 0});
+		}
+
+		void closeScope(size_t position) __attribute__((always_inline))
+		{
+			m_scopes[m_open.back()].m_last=position;
+			m_open.pop_back();
+		}
+
+		// position of the bracket that closes the one at first
+		size_t scopeEnd(size_t first) const
+		{
+			auto it=std::lower_bound(m_scopes.begin(), m_scopes.end(), first, [](const Scope& scope, size_t position){
+				return scope.m_first<position;
+			});
+			return it->m_last;
+		}
+
+	private:
+		struct Scope
+		{
+			uint32_t m_first;
+			uint32_t m_last;
+		};
+
+		std::vector<Scope> m_scopes;
+		std::vector<uint32_t> m_open; // scopes not closed yet
+
+		ScopeMap(const ScopeMap&)=delete;
+		ScopeMap& operator=(const ScopeMap&)=delete;
+};
+
+//====================================================================
+
+/*
+ * The grammar of JsonParser::parseEntries without the nodes: the
+ * events are passed to the handler as they are found. The input is
+ * never written to and is not read past length. Duplicate keys are
+ * looked for only when keys is not null, the extent of every object
+ * and array is recorded only when scopeMap is not null.
+ *
+ * Returns ErrorCode::error0 for a valid document, otherwise position
+ * is the offset of the byte where the error was found (the end of the
+ * input, whitespace aside, when the document is incomplete).
+ * */
+template<typename Handler>
+ErrorCode parseEvents(const char* str, size_t length, Handler& handler, ScopeStack& scopes, KeySet* keys, size_t& position, ScopeMap* scopeMap=nullptr)
+{
+	ErrorCode errorCode=ErrorCode::error0;
+	scopes.clear();
+	position=0;
+
+	if(length>StructuralIndex::c_MAX_LENGTH){
+		return ErrorCode::error28;
+	}
+
+	/*
+	 * As for JsonObj::parseInSitu, a scalar at the end is left out of
+	 * the index and reported below, so nothing is read past length.
+	 * */
+	const size_t fullLength=length;
+	while(length>0 && int(str[length-1])<33){
+		length--;
+	}
+	const size_t scalarEnd=length;
+	while(length>0 && StructuralIndex::isScalarByte(str[length-1])){
+		length--;
+	}
+	bool trailingScalar=scalarEnd>length;
+
+	StructuralIndex index(str, length);
+	SyntaxRules rule;
+
+	// where JsonParser::parseEntries would stand on a key or an object node
+	bool keyNode=true;
+	bool closed=false;
+
+	uint32_t entry;
+	size_t i=0;
+	while((entry=index.next())!=StructuralIndex::c_END){
+		i=entry;
+
+		switch(str[i]){
+			case '"':
+				{
+					if(closed){ // the root scope is already closed
+						errorCode=ErrorCode::error26;
+						goto FINISH_JSON;
+					}
+
+					if(!keyNode){
+						if(!rule.syntaxRuleValue()){
+							errorCode=ErrorCode::error1;
+							goto FINISH_JSON;
+						}
+					}
+					else if(!rule.syntaxRuleKey()){
+						errorCode=ErrorCode::error9;
+						goto FINISH_JSON;
+					}
+
+					uint32_t closing=index.next();
+					if(closing==StructuralIndex::c_END){
+						// unterminated string, reported as an open scope below
+						trailingScalar=false; // if any, it is part of the string
+						i=scalarEnd;
+						goto FINISH_JSON;
+					}
+
+					const bool dirty=closing & StructuralIndex::c_DIRTY;
+					if(dirty){
+						closing&=~StructuralIndex::c_DIRTY;
+
+						size_t j=i+1;
+						while(true){
+							j=findEscapeOrControl(str+j, str+closing)-str;
+							if(j>=closing){
+								break;
+							}
+
+							if(str[j]!='\\'){//control characters
+								i=j;
+								errorCode=ErrorCode::error1;
+								goto FINISH_JSON;
+							}
+
+							if(str[j+1]=='u'){
+								if(!isHexValid(str+j+1)){
+									i=j;
+									errorCode=ErrorCode::error1;
+									goto FINISH_JSON;
+								}
+								j+=6; // \u(H1)(H2)(H3)(H4)
+								continue;
+							}
+
+							if(str[j+1]!='"' && str[j+1]!='\\' && str[j+1]!='/' && str[j+1]!='b'
+								&& str[j+1]!='f' && str[j+1]!='n' && str[j+1]!='r' && str[j+1]!='t')
+							{
+								i=j;
+								errorCode=ErrorCode::error1;
+								goto FINISH_JSON;
+							}
+							j+=2;
+						}
+					}
+
+					std::string_view value(str+i+1, closing-i-1);
+					if(keyNode){
+						if(keys && !keys->insert(i+1, closing-i-1, dirty)){
+							errorCode=ErrorCode::error17;
+							goto FINISH_JSON;
+						}
+
+						handler.key(value);
+						rule.setRuleColon();
+					}
+					else{
+						handler.string(value);
+						rule.setRuleReady();
+					}
+					break;
+				}
+			case '{':
+				{
+					if(!rule.syntaxRuleValue() && !rule.syntaxRuleInitial()){
+						errorCode=ErrorCode::error9;
+						goto FINISH_JSON;
+					}
+
+					handler.startObject();
+					if(scopeMap){
+						scopeMap->openScope(i);
+					}
+
+					scopes.push(true);
+					if(keys){
+						keys->openScope();
+					}
+					keyNode=true;
+					rule.setRuleObj();
+					break;
+				}
+			case '}':
+				{
+					if(!rule.syntaxRuleObj()){
+						errorCode=ErrorCode::error3;
+						goto FINISH_JSON;
+					}
+
+					if(scopes.empty() || !scopes.isObj()){
+						errorCode=ErrorCode::error11;
+						goto FINISH_JSON;
+					}
+
+					handler.endObject();
+					if(scopeMap){
+						scopeMap->closeScope(i);
+					}
+
+					scopes.pop();
+					if(keys){
+						keys->closeScope();
+					}
+					closed=scopes.empty();
+					keyNode=!closed && scopes.isObj();
+					rule.setRuleReady(!closed);
+					break;
+				}
+			case '[':
+				{
+					if(!rule.syntaxRuleValue() && !rule.syntaxRuleInitial()){
+						errorCode=ErrorCode::error2;
+						goto FINISH_JSON;
+					}
+
+					handler.startArray();
+					if(scopeMap){
+						scopeMap->openScope(i);
+					}
+
+					scopes.push(false);
+					keyNode=false;
+					rule.setRuleArr();
+					break;
+				}
+			case ']':
+				{
+					if(!rule.syntaxRuleArr()){
+						errorCode=ErrorCode::error1;
+						goto FINISH_JSON;
+					}
+
+					if(scopes.empty() || scopes.isObj()){
+						errorCode=ErrorCode::error11;
+						goto FINISH_JSON;
+					}
+
+					handler.endArray();
+					if(scopeMap){
+						scopeMap->closeScope(i);
+					}
+
+					scopes.pop();
+					closed=scopes.empty();
+					keyNode=!closed && scopes.isObj();
+					rule.setRuleReady(!closed);
+					break;
+				}
+			case ',':
+				{
+					if(!rule.syntaxRuleReady()){
+						errorCode=ErrorCode::error1;
+						goto FINISH_JSON;
+					}
+
+					if(scopes.isObj()){
+						keyNode=true;
+						rule.setRuleKey();
+					}
+					else{
+						keyNode=false;
+						rule.setRuleValue();
+					}
+					break;
+				}
+			case ':':
+				{
+					if(!rule.syntaxRuleColon()){
+						errorCode=ErrorCode::error1;
+						goto FINISH_JSON;
+					}
+
+					keyNode=false;
+					rule.setRuleValue();
+					break;
+				}
+			default:
+				{
+					if(!rule.syntaxRuleValue()){
+						errorCode=ErrorCode::error1;
+						goto FINISH_JSON;
+					}
+
+					JSON_TYPES type;
+
+					int a=scanScalar(str+i, type, errorCode);
+					if(a<0){
+						goto FINISH_JSON;
+					}
+
+					// only the first byte of a scalar is indexed, e.g. 'truex'
+					if(StructuralIndex::isScalarByte(str[i+a+1])){
+						errorCode=ErrorCode::error1;
+						goto FINISH_JSON;
+					}
+
+					if(type==JSON_TYPES::_NULL){
+						handler.null();
+					}
+					else if(type==JSON_TYPES::_BOOL){
+						handler.boolean(str[i]=='t');
+					}
+					else{
+						handler.number(std::string_view(str+i, a+1));
+					}
+
+					rule.setRuleReady();
+					break;
+				}
+		}
+	}
+
+	i=scalarEnd;
+
+	FINISH_JSON:
+
+	if(errorCode==ErrorCode::error0 && trailingScalar){
+		// reported as JsonObj::parse does, with a '\0' after the scalar
+		i=length;
+		if(!rule.syntaxRuleValue()){
+			errorCode=ErrorCode::error1;
+		}
+		else{
+			/*
+			 * Whitespace after the scalar stops it as a '\0' would,
+			 * otherwise it is copied (no heap unless it is very long).
+			 * */
+			const size_t scalarLength=scalarEnd-length;
+			char local[64];
+			std::string copy;
+			const char* scalar=str+length;
+			if(scalarEnd==fullLength){
+				if(scalarLength<sizeof(local)){
+					std::memcpy(local, scalar, scalarLength);
+					local[scalarLength]='\0';
+					scalar=local;
+				}
+				else{
+					copy.assign(scalar, scalarLength);
+					scalar=copy.c_str();
+				}
+			}
+
+			JSON_TYPES type;
+			int a=scanScalar(scalar, type, errorCode);
+			if(a>=0 && size_t(a+1)<scalarLength){ // e.g. 'truex'
+				errorCode=ErrorCode::error1;
+			}
+		}
+		if(errorCode==ErrorCode::error0){
+			i=scalarEnd;
+		}
+	}
+
+	if(errorCode==ErrorCode::error0){
+		if(!scopes.empty()){
+			errorCode=ErrorCode::error3;
+		}
+		else if(rule.syntaxRuleInitial()){
+			errorCode=ErrorCode::error21;
+		}
+	}
+
+	position=i;
+
+	return errorCode;
+}
+
+//====================================================================
+
+}//internal
+} // easyjson namespace
+
+#endif
@@ -10,8 +10,11 @@
 #define JSON_CORE_H
 
 #include <string>
+#include <string_view>
 #include <cstring>
+#include <cstdint>
 #include <vector>
+#include <algorithm>
 #include <functional>
 
 #include "easyjson/internal/custom_allocator.h"
@@ -26,32 +29,243 @@ namespace internal
 
 //====================================================================
 
+/*
+ * Tag for the buffer that parses in the caller's memory.
+ * */
+struct in_situ{};
+
+class ScopeMap;
+
+//====================================================================
+
+/*
+ * Symbol table of the keys of a document (ParseOptions::m_internKeys).
+ * Every distinct key gets an id, the offset of its first copy in the
+ * buffer, shared by all the key nodes with the same text: two keys
+ * are the same if and only if their offsets are, and a key that is not
+ * in the table is in no object of the document.
+ *
+ * Each key also gets a label that sorts like its text (the labels are
+ * spread over 64 bits and the new ones go half way between their
+ * neighbours, all of them are spread again when there is no room
+ * left), so the AVL trees go down comparing integers instead of
+ * strings. Past c_MAX_LABELS distinct keys the new ones get no label
+ * (0) and are compared with strcmp, either way agrees with the order
+ * of the objects.
+ *
+ * A copy of the texts is kept in the table, next to each other, so
+ * the comparisons never reach back into the document.
+ * */
+class KeyTable final
+{
+	public:
+		KeyTable()
+		: m_byText(c_MIN_SLOTS)
+		, m_byOffset(c_MIN_SLOTS)
+		{
+		}
+
+		~KeyTable()=default;
+
+		/*
+		 * Id of the key at offset (length bytes and a '\0'), which
+		 * becomes the id of its text if it is the first one.
+		 * */
+		uint32_t intern(const char* buffer, uint32_t offset, size_t length) __attribute__((always_inline)) __attribute__((hot))
+		{
+			const char* key=buffer+offset;
+			const uint32_t h=hash(key, length);
+			uint32_t idx=findText(key, length, h);
+			if(idx==0){
+				idx=add(key, length, h, offset);
+			}
+			return m_entries[idx-1].m_offset;
+		}
+
+		// 0 if key is not in the table, label is set otherwise
+		uint32_t lookup(const char* key, uint64_t& label) const __attribute__((hot))
+		{
+			const size_t length=std::strlen(key);
+			const uint32_t idx=findText(key, length, hash(key, length));
+			if(idx==0){
+				return 0;
+			}
+			label=m_entries[idx-1].m_label;
+			return m_entries[idx-1].m_offset;
+		}
+
+		// of the key with id offset, 0 if it has none
+		uint64_t label(uint32_t offset) const __attribute__((always_inline)) __attribute__((hot))
+		{
+			const size_t mask=m_byOffset.size()-1;
+			for(size_t i=mix(offset) & mask; ; i=(i+1) & mask){
+				const Label& slot=m_byOffset[i];
+				if(slot.m_offset==offset || slot.m_offset==0){
+					return slot.m_label;
+				}
+			}
+		}
+
+		/*
+		 * strcmp of two keys of the document, by their labels when both
+		 * have one.
+		 * */
+		int compare(const char* buffer, uint32_t left, uint32_t right) const __attribute__((always_inline)) __attribute__((hot))
+		{
+			if(left==right){
+				return 0;
+			}
+			const uint64_t leftLabel=label(left);
+			const uint64_t rightLabel=label(right);
+			if(leftLabel && rightLabel){
+				return leftLabel<rightLabel? -1 : 1;
+			}
+			return std::strcmp(buffer+left, buffer+right);
+		}
+
+		// the memory is kept
+		void clear();
+
+	private:
+		struct Entry
+		{
+			uint32_t m_offset; // id, in the document buffer
+			uint32_t m_text; // in m_texts
+			uint32_t m_length;
+			uint32_t m_hash;
+			uint64_t m_label;
+		};
+
+		struct Label
+		{
+			uint32_t m_offset;
+			uint64_t m_label; // a copy, kept next to the id
+		};
+
+		static constexpr size_t c_MIN_SLOTS=64;
+		static constexpr size_t c_MAX_LABELS=4096;
+
+		std::vector<Entry> m_entries;
+		std::string m_texts;
+		// open addressing, never more than half full: index in m_entries plus 1, 0 for an empty slot
+		std::vector<uint32_t> m_byText;
+		std::vector<Label> m_byOffset; // m_offset is 0 for an empty slot
+		std::vector<uint32_t> m_sorted; // entries with a label, by text
+
+		static uint32_t hash(const char* key, size_t length) __attribute__((always_inline))
+		{
+			uint64_t h=0x9E3779B97F4A7C15ULL ^ length;
+			for(; length>=8; key+=8, length-=8){
+				uint64_t word;
+				std::memcpy(&word, key, 8);
+				h=(h ^ word)*0xBF58476D1CE4E5B9ULL;
+				h^=h>>31;
+			}
+			if(length>0){
+				uint64_t word=0;
+				std::memcpy(&word, key, length);
+				h=(h ^ word)*0x94D049BB133111EBULL;
+				h^=h>>29;
+			}
+			return uint32_t(h ^ (h>>32));
+		}
+
+		static uint32_t mix(uint32_t offset) __attribute__((always_inline))
+		{
+			return uint32_t((uint64_t(offset)*0x9E3779B97F4A7C15ULL)>>32);
+		}
+
+		uint32_t findText(const char* key, size_t length, uint32_t h) const __attribute__((always_inline))
+		{
+			const size_t mask=m_byText.size()-1;
+			for(size_t i=h & mask; m_byText[i]!=0; i=(i+1) & mask){
+				const Entry& entry=m_entries[m_byText[i]-1];
+				if(entry.m_hash==h && entry.m_length==length && std::memcmp(m_texts.data()+entry.m_text, key, length)==0){
+					return m_byText[i];
+				}
+			}
+			return 0;
+		}
+
+		uint32_t add(const char* key, size_t length, uint32_t h, uint32_t offset);
+		void setLabel(uint32_t idx);
+		void setLabel(Entry& entry, uint64_t label);
+		void insertSlots(uint32_t idx);
+		void grow();
+};
+
+//====================================================================
+
 class JsonObjBuffer final
 {
 	public:
-		~JsonObjBuffer()=default;
+		~JsonObjBuffer();
 
 		const char* getDataAt(size_t offset) const
 		{
-			return m_buffer.data()+offset;
+			return m_data+offset;
 		}
 
 		size_t addData(const char* data, size_t inOffset=0);
 
+		// as addData, but a key already in the KeyTable is not added again
+		size_t addKey(const char* key)
+		{
+			if(!m_keys){
+				return addData(key);
+			}
+
+			uint64_t label;
+			if(uint32_t id=m_keys->lookup(key, label)){
+				return id;
+			}
+
+			size_t offset=addData(key);
+			m_keys->intern(m_data, offset, std::strlen(key));
+			return offset;
+		}
+
+		// nullptr unless the keys are interned
+		KeyTable* keys() const
+		{
+			return m_keys;
+		}
+
+		// from now on (until the buffer gets another document)
+		void internKeys()
+		{
+			if(!m_keys){
+				m_keys=new KeyTable();
+			}
+		}
+
+		// nullptr unless the nodes of the document live in an arena of their own
+		Allocator::Small_Object_Allocator::Arena* arena() const
+		{
+			return m_arena;
+		}
+
+		Allocator::Small_Object_Allocator::Arena* useArena()
+		{
+			if(!m_arena){
+				m_arena=new Allocator::Small_Object_Allocator::Arena();
+			}
+			return m_arena;
+		}
+
 		size_t getLengthAt(size_t offset) const
 		{
-			return std::strlen(m_buffer.data()+offset);
+			return std::strlen(m_data+offset);
 		}
 
 		int compare(size_t leftOffset, size_t rightOffset) const __attribute__((always_inline)) __attribute__((hot))
 		{
-			const char* data2 = m_buffer.data();
-			return std::strcmp(data2+leftOffset, data2+rightOffset);
+			return std::strcmp(m_data+leftOffset, m_data+rightOffset);
 		}
 
 		int comparing(const char* val, size_t offset) const __attribute__((always_inline)) __attribute__((hot))
 		{
-			return std::strcmp(val, m_buffer.data()+offset);
+			return std::strcmp(val, m_data+offset);
 		}
 
 		size_t bufferSize() const
@@ -59,28 +273,109 @@ class JsonObjBuffer final
 			return m_position;
 		}
 
+		// bytes held for the text, the caller's own for in situ documents
+		size_t bufferCapacity() const
+		{
+			if(m_mappedLength>0){
+				return m_mappedLength;
+			}
+			return isInSitu()? m_position : m_buffer.capacity();
+		}
+
+		bool isInSitu() const
+		{
+			return m_data!=m_buffer.data();
+		}
+
+		// parseLazy documents only, first is the opening bracket
+		size_t scopeEnd(size_t first) const;
+
 	private:
 		std::string m_buffer;
+		/*
+		 * Either m_buffer.data() or, for in situ documents, the
+		 * caller's buffer until the first edit that needs to grow it.
+		 * A read only mapping is never parsed, only copied from.
+		 * */
+		char* m_data;
 		size_t m_position{0};
+		size_t m_mappedLength{0}; // not 0 when m_data is a file mapping
+		ScopeMap* m_scopeMap{nullptr}; // parseLazy, where each container ends
+		ErrorCode m_scopeError{ErrorCode::error0}; // parseLazy, the first scope that could not be parsed
+		KeyTable* m_keys{nullptr};
+		Allocator::Small_Object_Allocator::Arena* m_arena{nullptr};
+
+		/*
+		 * The only copy of the input. std::string keeps a '\0' after
+		 * the last byte, which is all the padding the parser needs.
+		 * */
+		JsonObjBuffer(const char* str, size_t length)
+		: m_buffer(str, length)
+		, m_data(m_buffer.data())
+		, m_position(length)
+		{
+		}
 
-		JsonObjBuffer(const char* str, size_t bufferSize=0)
+		// The caller fills the buffer (i.e. reading a file)
+		explicit JsonObjBuffer(size_t length)
+		: m_buffer(length, '\0')
+		, m_data(m_buffer.data())
+		, m_position(length)
+		{
+		}
+
+		// No copy at all, the caller keeps the buffer alive
+		JsonObjBuffer(char* buffer, size_t length, in_situ)
+		: m_data(buffer)
+		, m_position(length)
 		{
-			if(bufferSize){
-				m_buffer.resize(bufferSize);
-			}
-			m_buffer=str;
-			m_position=m_buffer.length();
 		}
 
 		JsonObjBuffer()
-		: JsonObjBuffer(" ")
+		: JsonObjBuffer(" ", 1)
 		{}
 
+		/*
+		 * Private mapping of the file, writable for the parser to work
+		 * in place (the pages are duplicated up front, in the kernel) or
+		 * read only, i.e. for a JSON Lines file whose lines are copied
+		 * out one by one. Returns nullptr if the file cannot be mapped
+		 * or is longer than maxLength (it is not mapped then), fileLength
+		 * is set in any case (0 if the file cannot be opened).
+		 * */
+		static JsonObjBuffer* mapFile(const char* fileName, size_t& fileLength, bool writable=true, size_t maxLength=size_t(-1));
+
+		void releaseMapping();
+
+		// the next record of a JSON Lines file, the string keeps its capacity
+		void assign(const char* data, size_t length)
+		{
+			releaseMapping();
+			m_buffer.assign(data, length);
+			m_data=m_buffer.data();
+			m_position=length;
+			if(m_keys){
+				m_keys->clear();
+			}
+		}
+
+		// streaming, the chunks are appended as they arrive
+		void appendChunk(const char* data, size_t length)
+		{
+			m_buffer.append(data, length);
+			m_data=m_buffer.data();
+			m_position=m_buffer.size();
+		}
+
 		void resizeBuffer(size_t bufferSize)
 		{
 			m_buffer.resize(bufferSize);
+			m_data=m_buffer.data();
 		}
 
+		JsonObjBuffer(const JsonObjBuffer&)=delete;
+		JsonObjBuffer& operator=(const JsonObjBuffer&)=delete;
+
 	friend class easyjson::JsonImpl;
 	friend class easyjson::JsonParser;
 };
@@ -95,8 +390,15 @@ class NodeJson
 		Key=	1<<0,
 		Array=1<<1,
 		Obj=	1<<2,
+		LazyObj=1<<3,
+		LazyArray=1<<4,
+		Number=1<<5,
+		Escaped=1<<6, // on top of the others, see isEscaped()
+		Unindexed=1<<7, // on top of Obj, see isUnindexed()
 	};
 
+	static constexpr unsigned char c_KIND=(unsigned char)~(NodeMode::Escaped | NodeMode::Unindexed);
+
 	public:
 		NodeJson()=default;
 
@@ -115,19 +417,19 @@ class NodeJson
 		void setData(size_t offset, JSON_TYPES dataMode)
 		{
 			m_offset=offset;
-			m_dataMode=dataMode;
+			setDataMode(dataMode);
 		}
 
 		void setData(JsonObjBuffer& jsonBufferRef, const char* data, JSON_TYPES dataMode);
 
-		JSON_TYPES getDataMode() const
+		JSON_TYPES getDataMode() const __attribute__((always_inline))
 		{
-			return m_dataMode;
+			return dataMode();
 		}
 
-		void setDataMode(JSON_TYPES dataMode)
+		void setDataMode(JSON_TYPES dataMode) __attribute__((always_inline))
 		{
-			m_dataMode=dataMode;
+			storeDataMode(dataMode);
 		}
 
 		bool isDangling() const
@@ -137,37 +439,76 @@ class NodeJson
 
 		bool isKey() const __attribute__((always_inline))
 		{
-			return m_mode==NodeMode::Key;
+			return (mode() & c_KIND)==NodeMode::Key;
 		}
 
 		bool isObj() const __attribute__((always_inline))
 		{
-			return m_mode==NodeMode::Obj;
+			return (mode() & c_KIND)==NodeMode::Obj;
 		}
 
 		void setAsObj() __attribute__((always_inline))
 		{
-			m_mode=NodeMode::Obj;
-			m_dataMode=JSON_TYPES::_NA;
+			dropNumber();
+			setMode(NodeMode(NodeMode::Obj | (mode() & NodeMode::Unindexed)));
+			setDataMode(JSON_TYPES::_NA);
+		}
+
+		/*
+		 * Object whose keys are still the list ParseOptions::m_trustedInput
+		 * leaves: m_child is the last key and each key links the one
+		 * before it through m_left. AVL_Tree turns it into a tree the
+		 * first time it is asked for a key.
+		 * */
+		bool isUnindexed() const __attribute__((always_inline))
+		{
+			return mode() & NodeMode::Unindexed;
+		}
+
+		// O(1), the key is not compared with the others
+		void pushKey(NodeJson* node) __attribute__((always_inline))
+		{
+			node->setLeft(child());
+			setChild(node);
+			setMode(NodeMode(mode() | NodeMode::Unindexed));
 		}
 
 		void setNone() __attribute__((always_inline))
 		{
-			m_mode=NodeMode::None;
-			m_dataMode=JSON_TYPES::_NA;
+			dropNumber();
+			setMode(NodeMode::None);
+			setDataMode(JSON_TYPES::_NA);
 		}
 
 		bool isArray() const __attribute__((always_inline))
 		{
-			return m_mode==NodeMode::Array;
+			return (mode() & c_KIND)==NodeMode::Array;
 		}
 
 		void setAsArray() __attribute__((always_inline));
 		NodeJson* addArrayItem() __attribute__((always_inline));
 
+		/*
+		 * Object or array of a parseLazy document that has not been
+		 * accessed yet, m_offset is its opening bracket and the text
+		 * is left as it is until then.
+		 * */
+		bool isLazy() const __attribute__((always_inline))
+		{
+			return mode() & (NodeMode::LazyObj | NodeMode::LazyArray);
+		}
+
+		void setLazy(size_t offset, bool obj) __attribute__((always_inline))
+		{
+			dropNumber();
+			setMode(obj? NodeMode::LazyObj : NodeMode::LazyArray);
+			setDataMode(JSON_TYPES::_NA);
+			m_offset=offset;
+		}
+
 		bool isKeyObjArr() const
 		{
-			return (m_mode & NodeMode::Key) | (m_mode & NodeMode::Obj) | (m_mode & NodeMode::Array);
+			return (mode() & NodeMode::Key) | (mode() & NodeMode::Obj) | (mode() & NodeMode::Array) | isLazy();
 		}
 
 		bool hasData() const
@@ -177,27 +518,88 @@ class NodeJson
 		
 		bool isNumeric() const
 		{
-			return m_dataMode==JSON_TYPES::_NUM || m_dataMode==JSON_TYPES::_INT || m_dataMode==JSON_TYPES::_DOUBLE;
+			return getDataMode()==JSON_TYPES::_NUM || getDataMode()==JSON_TYPES::_INT || getDataMode()==JSON_TYPES::_DOUBLE;
 		}
 		
 		bool isString() const
 		{
-			return m_dataMode==JSON_TYPES::_STR;
+			return getDataMode()==JSON_TYPES::_STR;
 		}
 		
 		bool isBoolean() const
 		{
-			return m_dataMode==JSON_TYPES::_BOOL;
+			return getDataMode()==JSON_TYPES::_BOOL;
 		}
 		
 		bool isNull() const
 		{
-			return m_dataMode==JSON_TYPES::_NULL;
+			return getDataMode()==JSON_TYPES::_NULL;
 		}
 
 		bool isDouble() const
 		{
-			return m_dataMode==JSON_TYPES::_DOUBLE;
+			return getDataMode()==JSON_TYPES::_DOUBLE;
+		}
+
+		/*
+		 * Value node whose number was converted by the parser
+		 * (ParseOptions::m_decodeNumbers): _INT for an int64_t,
+		 * _DOUBLE otherwise. The text stays in the buffer.
+		 * */
+		bool isDecoded() const __attribute__((always_inline))
+		{
+			return (mode() & c_KIND)==NodeMode::Number;
+		}
+
+		void setNumber(int64_t value) __attribute__((always_inline))
+		{
+			setMode(NodeMode::Number);
+			setDataMode(JSON_TYPES::_INT);
+			m_integer=value;
+		}
+
+		void setNumber(double value) __attribute__((always_inline))
+		{
+			setMode(NodeMode::Number);
+			setDataMode(JSON_TYPES::_DOUBLE);
+			m_real=value;
+		}
+
+		/*
+		 * String (key or value) that holds a character the serializer
+		 * has to escape: '"', '\\', a control character, U+0000 or a
+		 * lone surrogate (see encodeUTF8). The others are copied out as
+		 * they are.
+		 * */
+		bool isEscaped() const __attribute__((always_inline))
+		{
+			return mode() & NodeMode::Escaped;
+		}
+
+		void setEscaped(bool escaped) __attribute__((always_inline))
+		{
+			setMode(NodeMode(escaped? (mode() | NodeMode::Escaped) : (mode() & c_KIND)));
+		}
+
+		static bool needsEscaping(const char* cstr)
+		{
+			for(; *cstr; cstr++){
+				unsigned char c=*cstr;
+				if(c<32 || c=='"' || c=='\\' || c==0xC0 || (c==0xED && (unsigned char)cstr[1]>=0xA0)){
+					return true;
+				}
+			}
+			return false;
+		}
+
+		int64_t getInteger() const
+		{
+			return m_integer;
+		}
+
+		double getReal() const
+		{
+			return m_real;
 		}
 
 		NodeJson* addChild() __attribute__((always_inline));
@@ -205,12 +607,18 @@ class NodeJson
 		NodeJson* addKeyNode() __attribute__((always_inline));
 		NodeJson* addKeyNode(JsonObjBuffer& jsonBufferRef, const char* data) __attribute__((always_inline));
 
+		// for a new key node
+		void setKey(JsonObjBuffer& jsonBufferRef, const char* key);
+
 		// Notice that key nodes are never clear
 		void clear();
 		void clearArray();
 
 		void print(const JsonObjBuffer& jsonBufferRef, std::string& str, bool pretty) const;
 
+		// the node and the ones under it, vectors are the ones of arrays
+		void countNodes(size_t& nodes, size_t& vectors) const;
+
 		static NodeJson* allocateNode() __attribute__((always_inline)) __attribute__((hot))
 		{
 			return s_allocator.construct();
@@ -223,8 +631,125 @@ class NodeJson
 
 	private:
 		static inline Allocator::Custom_Allocator<NodeJson> s_allocator;
-		
-		NodeJson* m_left{nullptr};  //for avl tree structure
+
+#ifdef JSON_COMPACT_NODES
+		/*
+		 * 16 bytes: links are 26 bit indices of blocks of the
+		 * NodeRegion (0 is null, it is the header of its first chunk).
+		 * m_bits holds the mode (bits 0-7), the data mode (8-11), the
+		 * height (12-17) and the low 14 bits of the child, whose other
+		 * 12 bits are on top of the left and right links.
+		 * */
+		static constexpr uint32_t c_INDEX_MASK=(uint32_t(1)<<26)-1;
+
+		uint32_t m_offset{0};
+		uint32_t m_bits{NodeMode::Key | (uint32_t(JSON_TYPES::_STR)<<8)};
+		union
+		{
+			uint32_t m_links[2]{0, 0}; //for avl tree structure
+			int64_t m_integer; // value nodes only, see isDecoded()
+			double m_real;
+		};
+
+		static NodeJson* at(uint32_t index) __attribute__((always_inline))
+		{
+			return index? reinterpret_cast<NodeJson*>(Allocator::NodeRegion::base()+(uintptr_t(index)<<4)) : nullptr;
+		}
+
+		static uint32_t indexOf(const void* ptr) __attribute__((always_inline))
+		{
+			return ptr? uint32_t((static_cast<const unsigned char*>(ptr)-Allocator::NodeRegion::base())>>4) : 0;
+		}
+
+		// links of decoded nodes are the number
+		NodeJson* linkAt(int lr) const __attribute__((always_inline))
+		{
+			return isDecoded()? nullptr : at(m_links[lr] & c_INDEX_MASK);
+		}
+
+		void setLinkAt(int lr, NodeJson* node) __attribute__((always_inline))
+		{
+			m_links[lr]=(m_links[lr] & ~c_INDEX_MASK) | indexOf(node);
+		}
+
+		uint32_t childIndex() const __attribute__((always_inline))
+		{
+			return (m_bits>>18) | ((m_links[0]>>26)<<14) | ((m_links[1]>>26)<<20);
+		}
+
+		void setChildIndex(uint32_t index) __attribute__((always_inline))
+		{
+			m_bits=(m_bits & 0x3FFFF) | (index<<18);
+			m_links[0]=(m_links[0] & c_INDEX_MASK) | ((index>>14)<<26);
+			m_links[1]=(m_links[1] & c_INDEX_MASK) | ((index>>20)<<26);
+		}
+
+		NodeJson* left() const __attribute__((always_inline))
+		{
+			return linkAt(0);
+		}
+
+		void setLeft(NodeJson* node) __attribute__((always_inline))
+		{
+			setLinkAt(0, node);
+		}
+
+		NodeJson* right() const __attribute__((always_inline))
+		{
+			return linkAt(1);
+		}
+
+		void setRight(NodeJson* node) __attribute__((always_inline))
+		{
+			setLinkAt(1, node);
+		}
+
+		NodeJson* child() const __attribute__((always_inline))
+		{
+			return isDecoded()? nullptr : at(childIndex());
+		}
+
+		void setChild(NodeJson* node) __attribute__((always_inline))
+		{
+			setChildIndex(indexOf(node));
+		}
+
+		int16_t height() const __attribute__((always_inline))
+		{
+			return (m_bits>>12) & 0x3F;
+		}
+
+		void setHeight(int16_t height) __attribute__((always_inline))
+		{
+			m_bits=(m_bits & ~(uint32_t(0x3F)<<12)) | (uint32_t(height & 0x3F)<<12);
+		}
+
+		NodeMode mode() const __attribute__((always_inline))
+		{
+			return NodeMode(m_bits & 0xFF);
+		}
+
+		void setMode(NodeMode mode) __attribute__((always_inline))
+		{
+			m_bits=(m_bits & ~uint32_t(0xFF)) | mode;
+		}
+
+		JSON_TYPES dataMode() const __attribute__((always_inline))
+		{
+			return JSON_TYPES((m_bits>>8) & 0xF);
+		}
+
+		void storeDataMode(JSON_TYPES dataMode) __attribute__((always_inline))
+		{
+			m_bits=(m_bits & ~(uint32_t(0xF)<<8)) | (uint32_t(dataMode)<<8);
+		}
+#else
+		union
+		{
+			NodeJson* m_left{nullptr};  //for avl tree structure
+			int64_t m_integer; // value nodes only, see isDecoded()
+			double m_real;
+		};
 		NodeJson* m_right{nullptr}; //for avl tree structure
 		NodeJson* m_child{nullptr};
 
@@ -233,6 +758,83 @@ class NodeJson
 		JSON_TYPES m_dataMode{JSON_TYPES::_STR};
 		NodeMode m_mode{NodeMode::Key};
 
+		NodeJson* left() const __attribute__((always_inline))
+		{
+			return m_left;
+		}
+
+		void setLeft(NodeJson* node) __attribute__((always_inline))
+		{
+			m_left=node;
+		}
+
+		NodeJson* right() const __attribute__((always_inline))
+		{
+			return m_right;
+		}
+
+		void setRight(NodeJson* node) __attribute__((always_inline))
+		{
+			m_right=node;
+		}
+
+		NodeJson* child() const __attribute__((always_inline))
+		{
+			return m_child;
+		}
+
+		void setChild(NodeJson* node) __attribute__((always_inline))
+		{
+			m_child=node;
+		}
+
+		int16_t height() const __attribute__((always_inline))
+		{
+			return m_height;
+		}
+
+		void setHeight(int16_t height) __attribute__((always_inline))
+		{
+			m_height=height;
+		}
+
+		NodeMode mode() const __attribute__((always_inline))
+		{
+			return m_mode;
+		}
+
+		void setMode(NodeMode mode) __attribute__((always_inline))
+		{
+			m_mode=mode;
+		}
+
+		JSON_TYPES dataMode() const __attribute__((always_inline))
+		{
+			return m_dataMode;
+		}
+
+		void storeDataMode(JSON_TYPES dataMode) __attribute__((always_inline))
+		{
+			m_dataMode=dataMode;
+		}
+#endif
+
+		// LEFT or RIGHT of AVL_Tree
+		NodeJson* branch(int lr) const __attribute__((always_inline))
+		{
+			return lr? right() : left();
+		}
+
+		void setBranch(int lr, NodeJson* node) __attribute__((always_inline))
+		{
+			if(lr){
+				setRight(node);
+			}
+			else{
+				setLeft(node);
+			}
+		}
+
 		class AVL_Tree
 		{
 			public:
@@ -249,20 +851,39 @@ class NodeJson
 
 				static NodeJson* find(const JsonObjBuffer& jsonBufferRef, NodeJson* obj, const char* key) __attribute__((always_inline)) __attribute__((hot));
 
+				/*
+				 * The keys of an unindexed object into a balanced tree, in
+				 * O(n log n). Of the keys with the same text the last one in
+				 * the document stays, the others are freed with their values.
+				 * */
+				static void buildIndex(const JsonObjBuffer& jsonBufferRef, NodeJson* obj);
+
 			private:
 				JsonObjBuffer& m_jsonBufferRef;
 				NodeJson* m_root{nullptr};
 
 				enum LR{LEFT, RIGHT};
-				NodeJson* NodeJson::* branch[2]={&NodeJson::m_left, &NodeJson::m_right};
 
 				void balance(NodeJson* node, int diff, NodeJson* top) __attribute__((hot));
 				int16_t insert(NodeJson* root, NodeJson* node, NodeJson* top);
 
 				bool removeNode(const char* key, NodeJson* node, NodeJson* top);
 				void removeNode(NodeJson* node, NodeJson* top);
+
+				static NodeJson* link(NodeJson** keys, size_t count);
 		};
 
+		// the keys of an unindexed object, one by one rather than recursively
+		void freeKeys();
+
+		// before the node takes another kind of value
+		void dropNumber() __attribute__((always_inline))
+		{
+			if(isDecoded()){
+				m_integer=0;
+			}
+		}
+
 		//----------- start AVL functionality -----------------
 
 		int diff();
@@ -328,6 +949,13 @@ class NodeJson
 				{
 					return m_container[idx];
 				}
+
+				// the items of other are moved to the end, other is left empty
+				void splice(VectWrapper& other)
+				{
+					m_container.insert(m_container.end(), other.m_container.begin(), other.m_container.end());
+					other.m_container.clear();
+				}
 				
 				NodeJson* getLast() __attribute__((always_inline))
 				{
@@ -370,39 +998,59 @@ class NodeJson
 
 		static inline Allocator::Custom_Allocator<VectWrapper> s_vectPool;
 
+		// of an array node
+		VectWrapper* vect() const __attribute__((always_inline))
+		{
+			return reinterpret_cast<VectWrapper*>(child());
+		}
+
+		void setVect(VectWrapper* vect) __attribute__((always_inline))
+		{
+			setChild(reinterpret_cast<NodeJson*>(vect));
+		}
+
+		void appendString(const JsonObjBuffer& jsonBufferRef, std::string& str) const;
 		void printMore(const JsonObjBuffer& jsonBufferRef, const std::string& spacer, const int padding, std::string& str, int indentation) const;
 		void prettify(const JsonObjBuffer& jsonBufferRef, std::string& str, int indentation, const std::string& spacer, const int padding) const;
 
 	friend class easyjson::JsonImpl;
 	friend class easyjson::JsonObj;
 	friend class easyjson::JsonParser;
+	friend class easyjson::ParserContext;
 };
 
+#ifdef JSON_COMPACT_NODES
+static_assert(sizeof(NodeJson)==16, "JSON_COMPACT_NODES expects a NodeJson of 16 bytes");
+#endif
+
 //====================================================================
 
 inline void NodeJson::setData(JsonObjBuffer& jsonBufferRef, const char* data, JSON_TYPES dataMode)
 {
 	size_t offset=jsonBufferRef.addData(data, m_offset);
 	setData(offset, dataMode);
+	setEscaped(dataMode==JSON_TYPES::_STR && needsEscaping(data));
 }
 
 //--------------------------------------------------------------------
 
 inline NodeJson* NodeJson::addChild()
 {
-	m_child=allocateNode();
-	return m_child;
+	NodeJson* node=allocateNode();
+	setChild(node);
+	return node;
 }
 
 //--------------------------------------------------------------------
 
 inline NodeJson* NodeJson::addBlankChild()
 {
-	m_child=allocateNode();
-	m_child->m_mode=NodeMode::None;
-	m_child->m_dataMode=JSON_TYPES::_NA;
+	NodeJson* node=allocateNode();
+	node->setMode(NodeMode::None);
+	node->setDataMode(JSON_TYPES::_NA);
+	setChild(node);
 	
-	return m_child;
+	return node;
 }
 
 //--------------------------------------------------------------------
@@ -414,10 +1062,18 @@ inline NodeJson* NodeJson::addKeyNode()
 
 //--------------------------------------------------------------------
 
+inline void NodeJson::setKey(JsonObjBuffer& jsonBufferRef, const char* key)
+{
+	setData(jsonBufferRef.addKey(key), JSON_TYPES::_STR);
+	setEscaped(needsEscaping(key));
+}
+
+//--------------------------------------------------------------------
+
 inline NodeJson* NodeJson::addKeyNode(JsonObjBuffer& jsonBufferRef, const char* data)
 {
 	NodeJson* keyNode=allocateNode();
-	keyNode->m_offset=jsonBufferRef.addData(data);
+	keyNode->setKey(jsonBufferRef, data);
 	
 	return keyNode;
 }
@@ -425,18 +1081,20 @@ inline NodeJson* NodeJson::addKeyNode(JsonObjBuffer& jsonBufferRef, const char*
 
 inline void NodeJson::clear()
 {
-	if(m_child){
+	if(child()){
 		if(isArray()){
-			VectWrapper* vect=reinterpret_cast<VectWrapper*>(m_child);
-			s_vectPool.freeMem(vect);
+			s_vectPool.freeMem(vect());
+		}
+		else if(isUnindexed()){
+			freeKeys();
 		}
 		else{
-			NodeJson::freeNode(m_child);
+			NodeJson::freeNode(child());
 		}
-		m_child=nullptr;
+		setChild(nullptr);
 	}
 
-	m_dataMode=JSON_TYPES::_NA;
+	setDataMode(JSON_TYPES::_NA);
 	m_offset=0;
 	setNone();
 }
@@ -446,8 +1104,8 @@ inline void NodeJson::clear()
 // Responsibility of caller to check if the node is array
 inline void NodeJson::clearArray()
 {
-	if(m_child){
-		VectWrapper* triePtr=reinterpret_cast<VectWrapper*>(m_child);
+	if(child()){
+		VectWrapper* triePtr=vect();
 		triePtr->clear();
 	}
 }
@@ -456,10 +1114,11 @@ inline void NodeJson::clearArray()
 
 inline void NodeJson::setAsArray()
 {
-	m_mode=NodeMode::Array;
-	m_dataMode=JSON_TYPES::_NA;
+	dropNumber();
+	setMode(NodeMode::Array);
+	setDataMode(JSON_TYPES::_NA);
 
-	m_child=reinterpret_cast<NodeJson*>(s_vectPool.construct());
+	setVect(s_vectPool.construct());
 }
 
 //--------------------------------------------------------------------
@@ -467,10 +1126,9 @@ inline void NodeJson::setAsArray()
 // Responsibility of caller to check if the node is array
 inline NodeJson* NodeJson::addArrayItem()
 {
-	VectWrapper& vect=reinterpret_cast<VectWrapper&>(*m_child);
 	NodeJson& node=*NodeJson::allocateNode();
 	node.setNone();
-	vect.push_back(&node);
+	vect()->push_back(&node);
 	return &node;
 }
 
@@ -492,11 +1150,11 @@ inline void NodeJson::print(const JsonObjBuffer& jsonBufferRef, std::string& str
 inline int NodeJson::diff()
 {
 	int a=0;
-	if(m_left){
-		a=-1*(m_left->m_height+1);
+	if(left()){
+		a=-1*(left()->height()+1);
 	}
-	if(m_right){
-		a=a+(m_right->m_height+1);
+	if(right()){
+		a=a+(right()->height()+1);
 	}
 	return a;
 }
@@ -509,19 +1167,19 @@ inline void NodeJson::bridge(NodeJson* tmp, NodeJson* top)
 		return;
 	}
 
-	if(top->m_right==this){
-		top->m_right=tmp;
+	if(top->right()==this){
+		top->setRight(tmp);
 		return;
 	}
-	top->m_left=tmp;
+	top->setLeft(tmp);
 }
 
 //--------------------------------------------------------------------
 
 inline int NodeJson::getLHeight()const
 {
-	if(m_left){
-		return m_left->m_height;
+	if(left()){
+		return left()->height();
 	}
 	return 0;
 }
@@ -530,8 +1188,8 @@ inline int NodeJson::getLHeight()const
 
 inline int NodeJson::getRHeight() const
 {
-	if(m_right){
-		return m_right->m_height;
+	if(right()){
+		return right()->height();
 	}
 	return 0;
 }
@@ -540,11 +1198,11 @@ inline int NodeJson::getRHeight() const
 
 inline void NodeJson::updateHeight()
 {
-	if(m_left || m_right){
-		m_height=std::max(getLHeight(), getRHeight())+1;	
+	if(left() || right()){
+		setHeight(std::max(getLHeight(), getRHeight())+1);	
 	}
 	else{
-		m_height=0;
+		setHeight(0);
 	}
 }
 
@@ -552,15 +1210,19 @@ inline void NodeJson::updateHeight()
 
 inline bool NodeJson::AVL_Tree::insertAt(NodeJson* obj, NodeJson* node)
 {
-	m_root=obj->m_child;
+	if(obj->isUnindexed()){
+		buildIndex(m_jsonBufferRef, obj);
+	}
+
+	m_root=obj->child();
 
 	if(!m_root){
-		obj->m_child=node;
+		obj->setChild(node);
 		return true;
 	}
 
 	int x=insert(m_root, node, nullptr);
-	obj->m_child=m_root;
+	obj->setChild(m_root);
 	return x!=-1;
 }
 
@@ -568,21 +1230,7 @@ inline bool NodeJson::AVL_Tree::insertAt(NodeJson* obj, NodeJson* node)
 
 inline NodeJson* NodeJson::AVL_Tree::find(NodeJson* obj, const char* key)
 {
-	NodeJson* node=obj->m_child;
-	int y;
-	while(node){
-		y=m_jsonBufferRef.comparing(key, node->m_offset);
-		if(y<0){
-			node=node->m_left;
-		}
-		else if(y>0){
-			node=node->m_right;
-		}
-		else{
-			break;
-		}
-	}
-	return node;
+	return find(m_jsonBufferRef, obj, key);
 }
 
 
@@ -591,15 +1239,34 @@ inline NodeJson* NodeJson::AVL_Tree::find(NodeJson* obj, const char* key)
 
 inline NodeJson* NodeJson::AVL_Tree::find(const JsonObjBuffer& jsonBufferRef, NodeJson* obj, const char* key)
 {
-	NodeJson* node=obj->m_child;
+	if(obj->isUnindexed()){
+		buildIndex(jsonBufferRef, obj);
+	}
+
+	NodeJson* node=obj->child();
+
+	if(const KeyTable* keys=jsonBufferRef.keys()){
+		uint64_t label;
+		const uint32_t id=keys->lookup(key, label);
+		if(id==0){
+			return nullptr;
+		}
+		while(node && node->m_offset!=id){
+			const uint64_t nodeLabel=label? keys->label(node->m_offset) : 0;
+			const bool left=nodeLabel? label<nodeLabel : jsonBufferRef.comparing(key, node->m_offset)<0;
+			node=left? node->left() : node->right();
+		}
+		return node;
+	}
+
 	int y;
 	while(node){
 		y=jsonBufferRef.comparing(key, node->m_offset);
 		if(y<0){
-			node=node->m_left;
+			node=node->left();
 		}
 		else if(y>0){
-			node=node->m_right;
+			node=node->right();
 		}
 		else{
 			break;
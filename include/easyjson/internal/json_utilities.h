@@ -9,6 +9,10 @@
 
 #include <cstring>
 #include <string>
+#include <limits>
+#include <cstdint>
+#include <charconv>
+#include <system_error>
 
 //====================================================================
 
@@ -18,6 +22,7 @@ namespace easyjson
 class JsonObj;
 class JsonImpl;
 class JsonParser;
+class ParserContext;
 
 enum class JSON_TYPES : unsigned char
 {
@@ -59,6 +64,112 @@ typedef jsonDataObjects<JsonDataObjects::_ARRAY> json_array;
 
 //====================================================================
 
+namespace internal
+{
+
+/*
+ * Shortest text that reads back as the same value (doubles and
+ * floats), no locale involved.
+ * */
+template<typename T>
+std::string numberToStr(T t)
+{
+	char buffer[32];
+	std::to_chars_result result=std::to_chars(buffer, buffer+sizeof(buffer), t);
+	return std::string(buffer, result.ptr);
+}
+
+/*
+ * str is a valid number that std::from_chars found too large or too
+ * small for T: the first significant digit and the exponent say which.
+ * */
+template<typename T>
+T outOfRange(const char* str)
+{
+	const char* c=str+(str[0]=='-');
+	int64_t magnitude=0;
+	bool fraction=false;
+	bool leading=true;
+	for(; (*c>47 && *c<58) || *c=='.'; c++){
+		if(*c=='.'){
+			fraction=true;
+		}
+		else if(leading && *c=='0'){
+			magnitude-=fraction;
+		}
+		else{
+			leading=false;
+			magnitude+=!fraction;
+		}
+	}
+
+	if(*c=='e' || *c=='E'){
+		c+=1+(c[1]=='+');
+		int64_t exponent=0;
+		if(std::from_chars(c, c+std::strlen(c), exponent).ec!=std::errc()){
+			exponent=c[0]=='-'? -(int64_t(1)<<40) : int64_t(1)<<40;
+		}
+		magnitude+=exponent;
+	}
+
+	T value=magnitude>0? std::numeric_limits<T>::infinity() : T(0);
+	return str[0]=='-'? -value : value;
+}
+
+// correctly rounded, as strtod would do it in the "C" locale
+template<typename T>
+T realFrom(const char* str)
+{
+	const char* last=str+std::strlen(str);
+	T value=0;
+	std::from_chars_result result=std::from_chars(str, last, value);
+	if(result.ec==std::errc::result_out_of_range){
+		return outOfRange<T>(str);
+	}
+	return value;
+}
+
+/*
+ * Out of range values are clamped, and a real (i.e. 2.5 or 1e3) is
+ * truncated toward zero instead of being read up to the '.' or 'e'.
+ * Anything that is not a number is 0.
+ * */
+template<typename T>
+T integerFrom(const char* str)
+{
+	const char* last=str+std::strlen(str);
+	T value=0;
+	std::from_chars_result result=std::from_chars(str, last, value);
+	if(result.ec==std::errc::result_out_of_range){
+		return str[0]=='-'? std::numeric_limits<T>::min() : std::numeric_limits<T>::max();
+	}
+
+	const char* c=result.ptr;
+	if(c!=last && *c=='.'){
+		while(*(++c)>47 && *c<58);
+		if(*c!='e' && *c!='E'){ // the digits read already are the integer part
+			return value;
+		}
+	}
+
+	if(c!=last && (*c=='e' || *c=='E')){
+		double real=realFrom<double>(str);
+		if(real>=double(std::numeric_limits<T>::max())){
+			return std::numeric_limits<T>::max();
+		}
+		if(real<=double(std::numeric_limits<T>::min())){
+			return std::numeric_limits<T>::min();
+		}
+		return real==real? static_cast<T>(real) : 0;
+	}
+
+	return value;
+}
+
+}//internal
+
+//====================================================================
+
 template<typename T>
 struct ToString
 {
@@ -104,7 +215,7 @@ struct ToString<size_t>
 
 	static std::string toStr(size_t t)
 	{
-		return std::to_string(t);
+		return internal::numberToStr(t);
 	}
 };
 
@@ -115,7 +226,7 @@ struct ToString<float>
 
 	static std::string toStr(float t)
 	{
-		return std::to_string(t);
+		return internal::numberToStr(t);
 	}
 };
 
@@ -126,7 +237,7 @@ struct ToString<double>
 
 	static std::string toStr(double t)
 	{
-		return std::to_string(t);
+		return internal::numberToStr(t);
 	}
 };
 
@@ -137,7 +248,7 @@ struct ToString<int>
 	
 	static std::string toStr(int t)
 	{
-		return std::to_string(t);
+		return internal::numberToStr(t);
 	}
 };
 
@@ -148,7 +259,7 @@ struct ToString<long>
 	
 	static std::string toStr(long t)
 	{
-		return std::to_string(t);
+		return internal::numberToStr(t);
 	}
 };
 
@@ -159,7 +270,7 @@ struct ToString<long long>
 	
 	static std::string toStr(long long t)
 	{
-		return std::to_string(t);
+		return internal::numberToStr(t);
 	}
 };
 
@@ -222,7 +333,7 @@ struct FromString<int>
 {
 	static int getFrom(const char* str)
 	{
-		return std::atoi(str);
+		return internal::integerFrom<int>(str);
 	}
 };
 
@@ -231,7 +342,7 @@ struct FromString<long>
 {
 	static long getFrom(const char* str)
 	{
-		return std::atol(str);
+		return internal::integerFrom<long>(str);
 	}
 };
 
@@ -240,7 +351,7 @@ struct FromString<long long>
 {
 	static long long getFrom(const char* str)
 	{
-		return std::atoll(str);
+		return internal::integerFrom<long long>(str);
 	}
 };
 
@@ -249,7 +360,7 @@ struct FromString<float>
 {
 	static float getFrom(const char* str)
 	{
-		return std::atof(str);
+		return internal::realFrom<float>(str);
 	}
 };
 
@@ -258,7 +369,7 @@ struct FromString<double>
 {
 	static double getFrom(const char* str)
 	{
-		return std::atof(str);
+		return internal::realFrom<double>(str);
 	}
 };
 
@@ -274,9 +385,26 @@ struct FromString<const char*>
 template<>
 struct FromString<std::string>
 {
+	// C0 80, how a decoded U+0000 is stored, comes back as '\0'
 	static std::string getFrom(const char* str)
 	{
-		return std::string(str);
+		std::string result(str);
+		size_t j=result.find('\xC0');
+		if(j==std::string::npos){
+			return result;
+		}
+
+		for(size_t i=j; i<result.length(); i++){
+			if(result[i]=='\xC0' && result[i+1]=='\x80'){
+				result[j++]='\0';
+				i++;
+			}
+			else{
+				result[j++]=result[i];
+			}
+		}
+		result.resize(j);
+		return result;
 	}
 };
 
@@ -397,6 +525,7 @@ struct JsonBulkList
 class JsonImpl;
 class JsonObj;
 class JsonParser;
+class JsonSax;
 
 enum class ErrorHandlerMode
 {
@@ -435,6 +564,8 @@ enum class ErrorCode
 	error24,
 	error25,
 	error26,
+	error27,
+	error28,
 	last,
 };
 
@@ -450,6 +581,7 @@ class ErrorReporting
 		
 		ErrorReporting(const ErrorReporting& other)
 		:m_errorCode(other.m_errorCode)
+		, m_position(other.m_position)
 		, c_errorHandlerMode(other.c_errorHandlerMode)
 		{
 		}
@@ -459,6 +591,11 @@ class ErrorReporting
 			return ErrorMessages[int(m_errorCode)];
 		}
 
+		static const char* getErrorMsg(ErrorCode errorCode)
+		{
+			return ErrorMessages[int(errorCode)];
+		}
+
 		bool isValid() const
 		{
 			return ErrorCode::error0==m_errorCode;
@@ -467,10 +604,21 @@ class ErrorReporting
 		void reset()
 		{
 			m_errorCode=ErrorCode::error0;
+			m_position=c_NO_POSITION;
+		}
+
+		// the errors that are not found in the input have no position
+		static constexpr size_t c_NO_POSITION=size_t(-1);
+
+		// offset of the byte where the error was found, c_NO_POSITION if there is none
+		size_t getPosition() const
+		{
+			return m_position;
 		}
 
 	private:
 		ErrorCode m_errorCode{ErrorCode::error0};
+		size_t m_position{c_NO_POSITION};
 		const ErrorHandlerMode c_errorHandlerMode;
 
 		static inline const char* ErrorMessages[int(ErrorCode::last)]{
@@ -500,7 +648,9 @@ class ErrorReporting
 		/*error23*/ "Invalid data conversion",
 		/*error24*/ "Key no found",
 		/*error25*/ "File is empty",
-		/*error26*/ "Expecting 'EOF', got 'undefined'"
+		/*error26*/ "Expecting 'EOF', got 'undefined'",
+		/*error27*/ "Invalid UTF-8 sequence",
+		/*error28*/ "JSON too large: the limit is 2GiB"
 		};
 
 		void setError(ErrorCode errorCode)
@@ -516,6 +666,12 @@ class ErrorReporting
 			}
 		}
 
+		void setError(ErrorCode errorCode, size_t position)
+		{
+			m_position=position;
+			setError(errorCode);
+		}
+
 		ErrorHandlerMode getMode() const
 		{
 			return c_errorHandlerMode;
@@ -524,6 +680,7 @@ class ErrorReporting
 	friend class easyjson::JsonImpl;
 	friend class easyjson::JsonObj;
 	friend class easyjson::JsonParser;
+	friend class easyjson::JsonSax;
 };
 
 }
@@ -549,68 +706,147 @@ inline bool isHexValid(const char* cstr)
 	return false;
 }
 
-inline bool pushUTF8CodePoint(std::string& str, char ch1, char ch2, char ch3, char ch4)
+/*
+ * Code point as UTF-8 at out, 4 bytes at most; the length is returned.
+ * U+0000 is written as C0 80 (as Java does) so that a decoded string
+ * stays NUL terminated, the serializer writes it back as \u0000. A
+ * lone surrogate takes 3 bytes, ED A0 to ED BF, and is written back
+ * as \uXXXX too.
+ * */
+inline int encodeUTF8(uint32_t val, char* out)
 {
-	uint32_t val=0;
-	int tmp=hexChar(int(ch1)); // 16*3
-	if(tmp<0){
-		return false;
+	if(val==0){
+		out[0]=char(0xC0);
+		out[1]=char(0x80);
+		return 2;
 	}
-	val+=4096*tmp; // 16*3
-
-	tmp=hexChar(int(ch2)); // 16^2
-	if(tmp<0){
-		return false;
+	else if(val<B0){
+		out[0]=char(val);
+		return 1;
 	}
-	val+=256*tmp;
-
-	tmp=hexChar(int(ch3));
-	if(tmp<0){
-		return false;
+	else if(val<B1){
+		out[0]=char((63 & (val>>6)) | 6<<5);
+		out[1]=char((63 & val) | B0);
+		return 2;
 	}
-	val+=16*tmp;
-	
-	tmp=hexChar(int(ch4));
-	if(tmp<0){
-		return false;
+	else if(val<B2){
+		out[0]=char((63 & (val>>12)) | 14<<4);
+		out[1]=char((63 & (val>>6)) | B0);
+		out[2]=char((63 & val) | B0);
+		return 3;
 	}
-	val+=tmp;
 
-	if(val<B0){
-		uint8_t data0=(63 & val);
-		str.push_back(data0);
-		return true;
+	out[0]=char((7 & (val>>18)) | 30<<3);
+	out[1]=char((63 & (val>>12)) | B0);
+	out[2]=char((63 & (val>>6)) | B0);
+	out[3]=char((63 & val) | B0);
+	return 4;
+}
+
+// the four hex digits after "\u", which isHexValid has checked
+inline uint32_t hexCodeUnit(const char* cstr)
+{
+	return (hexChar(int(cstr[0]))<<12) | (hexChar(int(cstr[1]))<<8) | (hexChar(int(cstr[2]))<<4) | hexChar(int(cstr[3]));
+}
+
+/*
+ * Decodes the \uXXXX sequence at cstr, joined with the one after it
+ * when they are a surrogate pair, into UTF-8 at out. out may overlap
+ * the sequence as long as it does not start after it: the result is
+ * never longer. Returns the number of bytes read, 0 if the hex digits
+ * are invalid, and sets written and codePoint.
+ * */
+inline int decodeUnicodeEscape(const char* cstr, char* out, int& written, uint32_t& codePoint)
+{
+	if(!isHexValid(cstr+1)){
+		return 0;
+	}
+
+	codePoint=hexCodeUnit(cstr+2);
+	int length=6;
+	if(codePoint>=0xD800 && codePoint<0xDC00 && cstr[6]=='\\' && isHexValid(cstr+7)){
+		uint32_t low=hexCodeUnit(cstr+8);
+		if(low>=0xDC00 && low<0xE000){
+			codePoint=0x10000+((codePoint-0xD800)<<10)+(low-0xDC00);
+			length=12;
+		}
 	}
-	else if(val<B1){
-		uint8_t data1=(63 & val) | B0;
-		uint8_t data0=(63 & (val>>6) ) | 6<<5;
-		str.push_back(data0);
-		str.push_back(data1);
-		return true;
+
+	// a lone surrogate is kept, 3 bytes (see encodeUTF8)
+	written=encodeUTF8(codePoint, out);
+	return length;
+}
+
+/*
+ * The escape sequences of a string already checked, decoded to out as
+ * JsonParser::parseEntries decodes them in place (see encodeUTF8).
+ * Returns the length written, never more than length.
+ * */
+inline size_t decodeEscapes(const char* cstr, size_t length, char* out)
+{
+	size_t k=0;
+	size_t i=0;
+	while(i<length){
+		if(cstr[i]!='\\'){
+			out[k++]=cstr[i++];
+			continue;
+		}
+
+		char decoded;
+		switch(cstr[i+1]){
+			case 'b':
+				decoded='\b';
+				break;
+			case 'f':
+				decoded='\f';
+				break;
+			case 'n':
+				decoded='\n';
+				break;
+			case 'r':
+				decoded='\r';
+				break;
+			case 't':
+				decoded='\t';
+				break;
+			case 'u':
+				{
+					int written;
+					uint32_t codePoint;
+					i+=decodeUnicodeEscape(cstr+i, out+k, written, codePoint);
+					k+=written;
+					continue;
+				}
+			default: // '"', '\\' and '/'
+				decoded=cstr[i+1];
+		}
+
+		out[k++]=decoded;
+		i+=2;
 	}
-	else if(val<B2){
-		uint8_t data2=(63 & val) | B0;
-		uint8_t data1=(63 & (val>>6)) | B0;
-		uint8_t data0=(63 & (val>>12) ) | 14<<4;
-		str.push_back(data0);
-		str.push_back(data1);
-		str.push_back(data2);
-		return true;
+	return k;
+}
+
+inline bool pushUTF8CodePoint(std::string& str, char ch1, char ch2, char ch3, char ch4)
+{
+	const char digits[4]={ch1, ch2, ch3, ch4};
+	for(char ch : digits){
+		if(hexChar(int(ch))<0){
+			return false;
+		}
 	}
-	else if(val<B3){
-		uint8_t data3=(63 & val) | B0;
-		uint8_t data2=(63 & (val>>6)) | B0;
-		uint8_t data1=(63 & (val>>12) ) | B0;
-		uint8_t data0=(63 & (val>>18) ) | 30<<3;
-		str.push_back(data0);
-		str.push_back(data1);
-		str.push_back(data2);
-		str.push_back(data3);
+
+	const uint32_t val=hexCodeUnit(digits);
+	if(val==0){ // a std::string holds '\0', no need for C0 80
+		str.push_back('\0');
 		return true;
 	}
-	return false;
-}
 
+	char buffer[4];
+	int length=encodeUTF8(val, buffer);
+	str.append(buffer, length);
+	return true;
+}
 }
 
 #endif
@@ -11,24 +11,131 @@
 
 #include <vector>
 #include <mutex>
+#include <new>
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#ifdef JSON_COMPACT_NODES
+#include <sys/mman.h>
+#endif
 
 //====================================================================
 
 namespace Allocator
 {
 
+#ifdef JSON_COMPACT_NODES
+#define CHUNK_SIZE 16
+#else
 #define CHUNK_SIZE 32
+#endif
 
 #define MEM_PAGE_SIZE 0x1000 // 4096
 
+// chunks of owned pools, aligned to their size
+#define OWNED_CHUNK_SIZE 0x10000 // 65536
+
+//====================================================================
+
+#ifdef JSON_COMPACT_NODES
+/*
+ * Address space the chunks of every pool come from when NodeJson is
+ * built with JSON_COMPACT_NODES: a block is named by its distance
+ * from base() in 16 byte units, which takes 26 bits for the 1GiB of
+ * the region. It is reserved once and never released, its pages are
+ * committed as they are touched and given back with the chunks.
+ * */
+class NodeRegion
+{
+	public:
+		static constexpr size_t c_SIZE=size_t(1)<<30;
+
+		static unsigned char* base() __attribute__((always_inline))
+		{
+			return s_base;
+		}
+
+		static unsigned char* takeChunk()
+		{
+			NodeRegion& region=instance();
+			std::lock_guard<std::mutex> lock(region.m_mutex);
+			if(!region.m_free.empty()){
+				unsigned char* chunk=region.m_free.back();
+				region.m_free.pop_back();
+				return chunk;
+			}
+
+			if(region.m_top==s_base+c_SIZE){
+				throw std::bad_alloc();
+			}
+
+			unsigned char* chunk=region.m_top;
+			region.m_top+=OWNED_CHUNK_SIZE;
+			return chunk;
+		}
+
+		static void giveChunk(unsigned char* chunk)
+		{
+			madvise(chunk, OWNED_CHUNK_SIZE, MADV_DONTNEED);
+
+			NodeRegion& region=instance();
+			std::lock_guard<std::mutex> lock(region.m_mutex);
+			region.m_free.push_back(chunk);
+		}
+
+	private:
+		static inline unsigned char* s_base{nullptr};
+
+		std::mutex m_mutex;
+		std::vector<unsigned char*> m_free;
+		unsigned char* m_top;
+
+		NodeRegion()
+		{
+			void* addr=mmap(nullptr, c_SIZE+OWNED_CHUNK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+			if(addr==MAP_FAILED){
+				throw std::bad_alloc();
+			}
+
+			s_base=reinterpret_cast<unsigned char*>((reinterpret_cast<uintptr_t>(addr)+OWNED_CHUNK_SIZE-1) & ~uintptr_t(OWNED_CHUNK_SIZE-1));
+			m_top=s_base;
+		}
+
+		// never destroyed, like the caches of the threads
+		static NodeRegion& instance()
+		{
+			static NodeRegion* region=new NodeRegion;
+			return *region;
+		}
+};
+
 //====================================================================
+#endif
 
 class MemPool
 {
 	public:
-		MemPool(size_t BLOCK_SIZE)
+		/*
+		 * An owned pool takes its chunks OWNED_CHUNK_SIZE at a time,
+		 * each one starting with a ChunkHeader (in place of its first
+		 * block), so the pool of any block is found with ownerOf and
+		 * fully free chunks can be released with trim. The others grow
+		 * their chunks one page at a time. With JSON_COMPACT_NODES all
+		 * of them are owned, their chunks are in the NodeRegion.
+		 * */
+		MemPool(size_t BLOCK_SIZE, bool owned=false)
 		: c_BLOCK_SIZE(BLOCK_SIZE)
 		, c_TOTAL_BLOCKS(MEM_PAGE_SIZE/c_BLOCK_SIZE>20? MEM_PAGE_SIZE/c_BLOCK_SIZE : 20)
+#ifdef JSON_COMPACT_NODES
+		, m_owned(true)
+#else
+		, m_owned(owned)
+#endif
 		{
 			m_pool.reserve(64);
 		}
@@ -36,10 +143,17 @@ class MemPool
 		MemPool(MemPool&& other)
 		: m_pool(std::move(other.m_pool))
 		, m_availableChunk{other.m_availableChunk}
+		, m_remote{other.m_remote.exchange(nullptr)}
 		, c_BLOCK_SIZE(other.c_BLOCK_SIZE)
 		, c_TOTAL_BLOCKS(other.c_TOTAL_BLOCKS)
+		, m_growBy(other.m_growBy)
+		, m_peakChunks(other.m_peakChunks)
+		, m_owned(other.m_owned)
 		{
 			other.m_availableChunk=nullptr;
+			for(auto chunk : m_pool){
+				setOwner(chunk);
+			}
 		}
 
 		MemPool(const MemPool&)=delete;
@@ -48,7 +162,10 @@ class MemPool
 		~MemPool()
 		{
 			for(auto chunk : m_pool){
-				if(chunk){
+				if(m_owned){
+					releaseChunk(chunk);
+				}
+				else if(chunk){
 					delete[] chunk;
 				}
 			}
@@ -57,6 +174,137 @@ class MemPool
 		unsigned char* allocateMem() __attribute__((always_inline)) __attribute__((hot));
 		void freeMem(void* ptr) __attribute__((always_inline));
 
+		/*
+		 * For a block of an owned pool freed by a thread other than the
+		 * one of the pool: it is pushed, lock free, on a list the pool
+		 * takes whole before it grows.
+		 * */
+		void freeRemote(void* ptr) __attribute__((always_inline))
+		{
+			unsigned char* block=reinterpret_cast<unsigned char*>(ptr);
+			unsigned char* head=m_remote.load(std::memory_order_relaxed);
+			do{
+				setNextAddr(block, head);
+			}while(!m_remote.compare_exchange_weak(head, block, std::memory_order_release, std::memory_order_relaxed));
+		}
+
+		// blocks of owned pools only
+		static MemPool* ownerOf(const void* ptr) __attribute__((always_inline))
+		{
+			return header(ptr)->m_owner;
+		}
+
+		/*
+		 * Releases the chunks of an owned pool none of whose blocks
+		 * are in use, returns the bytes released.
+		 * */
+		size_t trim();
+
+		struct Stats
+		{
+			size_t m_blockSize{0};
+			size_t m_liveBlocks{0};
+			size_t m_freeBlocks{0}; // length of the free list
+			size_t m_chunks{0};
+			size_t m_peakChunks{0};
+		};
+
+		// by the thread of the pool only, the remote list is taken
+		Stats stats()
+		{
+			if(unsigned char* remote=m_remote.exchange(nullptr, std::memory_order_acquire)){
+				freeList(remote);
+			}
+
+			Stats stats;
+			stats.m_blockSize=c_BLOCK_SIZE;
+			stats.m_freeBlocks=freeBlocks();
+			stats.m_chunks=m_pool.size();
+			stats.m_peakChunks=m_peakChunks;
+
+			// blocks of other pools may be in the free list
+			size_t blocks=m_owned? m_pool.size()*(OWNED_CHUNK_SIZE/c_BLOCK_SIZE-1) : pooledBytes()/c_BLOCK_SIZE;
+			stats.m_liveBlocks=blocks>stats.m_freeBlocks? blocks-stats.m_freeBlocks : 0;
+
+			return stats;
+		}
+
+		// bytes held in chunks
+		size_t pooledBytes() const
+		{
+			if(m_owned){
+				return m_pool.size()*OWNED_CHUNK_SIZE;
+			}
+			// chunk i has (i+1)*c_TOTAL_BLOCKS blocks
+			return m_pool.size()*(m_pool.size()+1)/2*c_TOTAL_BLOCKS*c_BLOCK_SIZE;
+		}
+
+		/*
+		 * Takes the chunks of other over, with its free blocks: what was
+		 * allocated from them stays valid and goes back to this pool.
+		 * */
+		void adopt(MemPool& other)
+		{
+			for(auto chunk : other.m_pool){
+				setOwner(chunk);
+			}
+			m_pool.insert(m_pool.end(), other.m_pool.begin(), other.m_pool.end());
+			other.m_pool.clear();
+
+			if(unsigned char* remote=other.m_remote.exchange(nullptr, std::memory_order_acquire)){
+				other.freeList(remote);
+			}
+
+			if(other.m_availableChunk){
+				unsigned char* last=other.m_availableChunk;
+				while(unsigned char* next=*(reinterpret_cast<unsigned char**>(last))){
+					last=next;
+				}
+				setNextAddr(last, m_availableChunk);
+				m_availableChunk=other.m_availableChunk;
+				other.m_availableChunk=nullptr;
+			}
+		}
+
+		/*
+		 * Moves count blocks (all of them if there are fewer) from the
+		 * free list to the one of other.
+		 * */
+		void lend(MemPool& other, size_t count)
+		{
+			if(count==0 || !m_availableChunk){
+				return;
+			}
+
+			unsigned char* first=m_availableChunk;
+			unsigned char* last=first;
+			for(size_t i=1; i<count; i++){
+				unsigned char* next=*(reinterpret_cast<unsigned char**>(last));
+				if(!next){
+					break;
+				}
+				last=next;
+			}
+
+			m_availableChunk=*(reinterpret_cast<unsigned char**>(last));
+			setNextAddr(last, other.m_availableChunk);
+			other.m_availableChunk=first;
+		}
+
+		size_t freeBlocks() const
+		{
+			size_t count=0;
+			for(unsigned char* next=m_availableChunk; next; next=*(reinterpret_cast<unsigned char**>(next))){
+				count++;
+			}
+			return count;
+		}
+
+		size_t blockSize() const
+		{
+			return c_BLOCK_SIZE;
+		}
+
 		void init() __attribute__((always_inline))
 		{
 			/*
@@ -65,33 +313,103 @@ class MemPool
 			 * needs 8bytes: |c_BLOCK_SIZE|c_BLOCK_SIZE|c_BLOCK_SIZE|...|c_BLOCK_SIZE|
 			 * (we can not write an address of 8bytes in a c_BLOCK_SIZE of 4!)
 			 * */
-			m_availableChunk=new unsigned char[m_growBy*c_TOTAL_BLOCKS*c_BLOCK_SIZE];
-
-			if(!m_availableChunk){
-				throw std::bad_alloc();
+			if(m_owned){
+				unsigned char* chunk=ownedChunk();
+				setOwner(chunk);
+				m_pool.emplace_back(chunk);
+				m_peakChunks=std::max(m_peakChunks, m_pool.size());
+				link(chunk+c_BLOCK_SIZE, OWNED_CHUNK_SIZE/c_BLOCK_SIZE-1);
+				return;
 			}
 
-			for(size_t i=0; i<c_TOTAL_BLOCKS*m_growBy; i++){
-				setNextAddr(&m_availableChunk[i*c_BLOCK_SIZE], &m_availableChunk[(i+1)*c_BLOCK_SIZE]);
+			unsigned char* chunk=new unsigned char[m_growBy*c_TOTAL_BLOCKS*c_BLOCK_SIZE];
+
+			if(!chunk){
+				throw std::bad_alloc();
 			}
 
-			setNextAddr(&m_availableChunk[(c_TOTAL_BLOCKS*m_growBy-1)*c_BLOCK_SIZE], nullptr);
-			m_pool.emplace_back(m_availableChunk);
+			m_pool.emplace_back(chunk);
+			m_peakChunks=std::max(m_peakChunks, m_pool.size());
+			link(chunk, c_TOTAL_BLOCKS*m_growBy);
 			m_growBy++;
 		}
 
 	private:
+		struct ChunkHeader
+		{
+			MemPool* m_owner;
+			uint32_t m_free; // free blocks, counted by trim
+		};
+
 		std::vector<unsigned char*> m_pool;
 		unsigned char* m_availableChunk{nullptr};
+		std::atomic<unsigned char*> m_remote{nullptr}; // freed by other threads
 		uint c_BLOCK_SIZE;
 		uint c_TOTAL_BLOCKS;
 		uint m_growBy{1};
+		size_t m_peakChunks{0};
+		bool m_owned;
 
 		static void setNextAddr(unsigned char* chunk, unsigned char* next) __attribute__((always_inline))
 		{
 			unsigned char** ptr=reinterpret_cast<unsigned char**>(chunk);
 			*ptr=next;
 		}
+
+		static ChunkHeader* header(const void* ptr) __attribute__((always_inline))
+		{
+			return reinterpret_cast<ChunkHeader*>(reinterpret_cast<uintptr_t>(ptr) & ~uintptr_t(OWNED_CHUNK_SIZE-1));
+		}
+
+		static unsigned char* ownedChunk()
+		{
+#ifdef JSON_COMPACT_NODES
+			return NodeRegion::takeChunk();
+#else
+			return static_cast<unsigned char*>(::operator new(OWNED_CHUNK_SIZE, std::align_val_t(OWNED_CHUNK_SIZE)));
+#endif
+		}
+
+		static void releaseChunk(unsigned char* chunk)
+		{
+#ifdef JSON_COMPACT_NODES
+			NodeRegion::giveChunk(chunk);
+#else
+			::operator delete(chunk, std::align_val_t(OWNED_CHUNK_SIZE));
+#endif
+		}
+
+		static unsigned char* next(unsigned char* block) __attribute__((always_inline))
+		{
+			return *(reinterpret_cast<unsigned char**>(block));
+		}
+
+		void setOwner(unsigned char* chunk)
+		{
+			if(m_owned){
+				reinterpret_cast<ChunkHeader*>(chunk)->m_owner=this;
+			}
+		}
+
+		// count blocks from first, in front of the free list
+		void link(unsigned char* first, size_t count)
+		{
+			for(size_t i=0; i<count-1; i++){
+				setNextAddr(&first[i*c_BLOCK_SIZE], &first[(i+1)*c_BLOCK_SIZE]);
+			}
+			setNextAddr(&first[(count-1)*c_BLOCK_SIZE], m_availableChunk);
+			m_availableChunk=first;
+		}
+
+		// list of other blocks, given to this pool
+		void freeList(unsigned char* list)
+		{
+			while(list){
+				unsigned char* next=*(reinterpret_cast<unsigned char**>(list));
+				freeMem(list);
+				list=next;
+			}
+		}
 };
 
 //--------------------------------------------------------------------
@@ -99,7 +417,12 @@ class MemPool
 inline unsigned char* MemPool::allocateMem()
 {
 	if(!m_availableChunk){
-		init();
+		if(m_remote.load(std::memory_order_relaxed)){
+			m_availableChunk=m_remote.exchange(nullptr, std::memory_order_acquire);
+		}
+		else{
+			init();
+		}
 	}
 
 	unsigned char* tmp=m_availableChunk;
@@ -117,6 +440,64 @@ inline void MemPool::freeMem(void* obj)
 	m_availableChunk=reinterpret_cast<unsigned char*>(obj);
 }
 
+//--------------------------------------------------------------------
+/*
+ * The free list may hold blocks of chunks of other pools (i.e. freed
+ * in a ThreadPools scope), those are left alone: their chunks are not
+ * fully free in the pool that owns them.
+ * */
+
+inline size_t MemPool::trim()
+{
+	if(!m_owned || m_pool.empty()){
+		return 0;
+	}
+
+	if(unsigned char* remote=m_remote.exchange(nullptr, std::memory_order_acquire)){
+		freeList(remote);
+	}
+
+	for(auto chunk : m_pool){
+		reinterpret_cast<ChunkHeader*>(chunk)->m_free=0;
+	}
+
+	for(unsigned char* block=m_availableChunk; block; block=next(block)){
+		ChunkHeader* chunk=header(block);
+		if(chunk->m_owner==this){
+			chunk->m_free++;
+		}
+	}
+
+	const uint32_t blocks=OWNED_CHUNK_SIZE/c_BLOCK_SIZE-1;
+	auto isFree=[this, blocks](unsigned char* block){
+		ChunkHeader* chunk=header(block);
+		return chunk->m_owner==this && chunk->m_free==blocks;
+	};
+
+	unsigned char** link=&m_availableChunk;
+	while(unsigned char* block=*link){
+		if(isFree(block)){
+			*link=next(block);
+		}
+		else{
+			link=reinterpret_cast<unsigned char**>(block);
+		}
+	}
+
+	size_t released=0;
+	auto last=std::remove_if(m_pool.begin(), m_pool.end(), [&](unsigned char* chunk){
+		if(reinterpret_cast<ChunkHeader*>(chunk)->m_free==blocks){
+			releaseChunk(chunk);
+			released+=OWNED_CHUNK_SIZE;
+			return true;
+		}
+		return false;
+	});
+	m_pool.erase(last, m_pool.end());
+
+	return released;
+}
+
 //====================================================================
 
 class Small_Object_Allocator
@@ -141,9 +522,263 @@ class Small_Object_Allocator
 		template<typename T>
 		void free(T* p);
 
+		/*
+		 * Releases the fully free chunks of the cache of the calling
+		 * thread and of the caches left by the threads that exited,
+		 * returns the bytes released.
+		 * */
+		static size_t trim();
+
+		/*
+		 * By size class, the pools of the calling thread added to the
+		 * ones of the threads that exited.
+		 * */
+		static std::vector<MemPool::Stats> stats();
+
+		/*
+		 * Past bytes pooled by the cache of a thread, the thread trims
+		 * it when it releases a document (see trimAboveWatermark). Zero,
+		 * the default, never trims.
+		 * */
+		static void setHighWatermark(size_t bytes)
+		{
+			s_highWatermark.store(bytes, std::memory_order_relaxed);
+		}
+
+		static void trimAboveWatermark() __attribute__((always_inline))
+		{
+			size_t mark=s_highWatermark.load(std::memory_order_relaxed);
+			std::vector<MemPool>* cache=s_cache;
+			if(mark && cache && pooledBytes(*cache)>mark){
+				trim();
+			}
+		}
+
+		/*
+		 * While alive, the thread allocates from pools of the scope
+		 * instead of its cache, and frees into them whatever the owner
+		 * of the block. Everything allocated in the scope must be
+		 * released (or handed over) before it ends.
+		 * */
+		class ThreadPools
+		{
+			public:
+				// loan as made by lend()
+				explicit ThreadPools(std::vector<MemPool>&& loan={})
+				: m_allocators(std::move(loan))
+				{
+					s_threadAllocators=&m_allocators;
+					init();
+				}
+
+				~ThreadPools()
+				{
+					if(s_threadAllocators==&m_allocators){
+						s_threadAllocators=nullptr;
+					}
+				}
+
+				/*
+				 * For memory that has to outlive the scope (i.e. the part
+				 * of a document built by a worker thread): it is moved to
+				 * the pools of the calling thread, once the thread that
+				 * owned the scope is done with it.
+				 * */
+				void handOver()
+				{
+					std::vector<MemPool>& heir=pools();
+					for(size_t i=0; i<m_allocators.size(); i++){
+						heir[i].adopt(m_allocators[i]);
+					}
+				}
+
+			private:
+				std::vector<MemPool> m_allocators;
+
+				ThreadPools(const ThreadPools&)=delete;
+				ThreadPools& operator=(const ThreadPools&)=delete;
+		};
+
+		/*
+		 * Pools of one document (ParseOptions::m_arena), blocks above
+		 * c_max_object_size included. The document is released by
+		 * deleting its arena: the chunks go in one go, the nodes in them
+		 * are neither visited nor destroyed one by one.
+		 * */
+		class Arena
+		{
+			public:
+				Arena()
+				{
+					makePools(m_pools, false);
+					m_large.m_prev=&m_large;
+					m_large.m_next=&m_large;
+				}
+
+				~Arena()
+				{
+					LargeBlock* block=m_large.m_next;
+					while(block!=&m_large){
+						LargeBlock* next=block->m_next;
+						::operator delete(block);
+						block=next;
+					}
+				}
+
+				/*
+				 * While alive, what the thread allocates and frees goes to
+				 * arena, nothing is done for a null arena.
+				 * */
+				class Scope
+				{
+					public:
+						explicit Scope(Arena* arena) __attribute__((always_inline))
+						: m_arena(arena)
+						{
+							if(arena){
+								m_previous=s_arena;
+								m_previousPools=s_threadAllocators;
+								s_arena=arena;
+								s_threadAllocators=&arena->m_pools;
+							}
+						}
+
+						~Scope() __attribute__((always_inline))
+						{
+							if(m_arena){
+								s_arena=m_previous;
+								s_threadAllocators=m_previousPools;
+							}
+						}
+
+					private:
+						Arena* m_arena;
+						Arena* m_previous{nullptr};
+						std::vector<MemPool>* m_previousPools{nullptr};
+
+						Scope(const Scope&)=delete;
+						Scope& operator=(const Scope&)=delete;
+				};
+
+			private:
+				// ahead of each block above c_max_object_size, 16 bytes to keep the alignment
+				struct alignas(16) LargeBlock
+				{
+					LargeBlock* m_prev;
+					LargeBlock* m_next;
+				};
+
+				std::vector<MemPool> m_pools;
+				LargeBlock m_large; // the list of the large blocks
+
+				void* allocateLarge(std::size_t size)
+				{
+					LargeBlock* block=static_cast<LargeBlock*>(::operator new(sizeof(LargeBlock)+size));
+					block->m_prev=&m_large;
+					block->m_next=m_large.m_next;
+					m_large.m_next->m_prev=block;
+					m_large.m_next=block;
+					return block+1;
+				}
+
+				void freeLarge(void* p)
+				{
+					LargeBlock* block=static_cast<LargeBlock*>(p)-1;
+					block->m_prev->m_next=block->m_next;
+					block->m_next->m_prev=block->m_prev;
+					::operator delete(block);
+				}
+
+				Arena(const Arena&)=delete;
+				Arena& operator=(const Arena&)=delete;
+
+			friend class Small_Object_Allocator;
+		};
+
+		/*
+		 * The blocks of a document built by several threads belong to
+		 * the calling thread once handed over, so after the document is
+		 * released its cache holds all of them. They are lent in equal
+		 * shares (one share is kept) to the ThreadPools of the threads
+		 * building the next one, which hand them over back when done.
+		 * */
+		static std::vector<std::vector<MemPool>> lend(unsigned shares)
+		{
+			std::vector<MemPool>& lender=pools();
+
+			std::vector<std::vector<MemPool>> loans(shares);
+			for(auto& loan : loans){
+				loan.reserve(lender.size());
+				for(auto& pool : lender){
+					loan.emplace_back(pool.blockSize(), true);
+				}
+			}
+
+			for(size_t i=0; i<lender.size(); i++){
+				size_t share=lender[i].freeBlocks()/(shares+1);
+				for(auto& loan : loans){
+					lender[i].lend(loan[i], share);
+				}
+			}
+
+			return loans;
+		}
+
 	private:
-		static inline std::vector<MemPool> m_allocators;
-		static inline std::size_t c_max_object_size{2048};
+		static constexpr std::size_t c_max_object_size{2048};
+
+		static inline thread_local std::vector<MemPool>* s_threadAllocators __attribute__((tls_model("initial-exec"))){nullptr};
+		static inline thread_local Arena* s_arena __attribute__((tls_model("initial-exec"))){nullptr};
+
+		/*
+		 * Each thread allocates from a cache of owned pools, taken on
+		 * first use and given back for another thread to take when it
+		 * exits. A block freed by a thread other than its owner goes
+		 * to the remote list of the owner pool.
+		 * */
+		static inline thread_local std::vector<MemPool>* s_cache __attribute__((tls_model("initial-exec"))){nullptr};
+		static inline thread_local bool s_cacheGone __attribute__((tls_model("initial-exec"))){false};
+		static inline std::atomic<size_t> s_highWatermark{0};
+
+		static size_t pooledBytes(const std::vector<MemPool>& allocators)
+		{
+			size_t bytes=0;
+			for(const auto& pool : allocators){
+				bytes+=pool.pooledBytes();
+			}
+			return bytes;
+		}
+
+		static size_t trim(std::vector<MemPool>& allocators)
+		{
+			size_t released=0;
+			for(auto& pool : allocators){
+				released+=pool.trim();
+			}
+			return released;
+		}
+
+		struct CacheHolder
+		{
+			~CacheHolder();
+		};
+
+		static std::mutex& sparesMutex();
+		static std::vector<std::vector<MemPool>*>& spares();
+		static std::vector<MemPool>& takeCache();
+
+		static void makePools(std::vector<MemPool>& allocators, bool owned=true);
+
+		static std::vector<MemPool>& pools() __attribute__((always_inline))
+		{
+			if(std::vector<MemPool>* threadAllocators=s_threadAllocators){
+				return *threadAllocators;
+			}
+			if(std::vector<MemPool>* cache=s_cache){
+				return *cache;
+			}
+			return takeCache();
+		}
 
 		Small_Object_Allocator(const Small_Object_Allocator&);
 		Small_Object_Allocator& operator=(const Small_Object_Allocator&);
@@ -159,22 +794,136 @@ class Small_Object_Allocator
 
 inline void Small_Object_Allocator::init()
 {
-	if(m_allocators.size()>0){
+	std::vector<MemPool>& allocators=pools();
+	if(allocators.size()>0){
 		return;
 	}
 
+	makePools(allocators);
+}
+
+//--------------------------------------------------------------------
+
+inline void Small_Object_Allocator::makePools(std::vector<MemPool>& allocators, bool owned)
+{
 	size_t bins=0;
 	while(c_max_object_size>=(size_t(CHUNK_SIZE)<<bins)){
 		bins++;
 	}
 	
-	m_allocators.reserve(bins);
+	allocators.reserve(bins);
 
 	for(size_t i=0; i<bins; i++){
-		m_allocators.emplace_back(CHUNK_SIZE<<i);
+		allocators.emplace_back(CHUNK_SIZE<<i, owned);
 	}
 	
-	m_allocators[0].init();
+	allocators[0].init();
+}
+
+//--------------------------------------------------------------------
+
+inline Small_Object_Allocator::CacheHolder::~CacheHolder()
+{
+	std::lock_guard<std::mutex> lock(sparesMutex());
+	spares().push_back(s_cache);
+	s_cache=nullptr;
+	s_cacheGone=true;
+}
+
+//--------------------------------------------------------------------
+// never destroyed, other threads may still free into the caches
+
+inline std::mutex& Small_Object_Allocator::sparesMutex()
+{
+	static std::mutex* mutex=new std::mutex;
+	return *mutex;
+}
+
+inline std::vector<std::vector<MemPool>*>& Small_Object_Allocator::spares()
+{
+	static std::vector<std::vector<MemPool>*>* caches=new std::vector<std::vector<MemPool>*>;
+	return *caches;
+}
+
+//--------------------------------------------------------------------
+
+__attribute__((noinline)) inline std::vector<MemPool>& Small_Object_Allocator::takeCache()
+{
+	std::vector<MemPool>* cache=nullptr;
+	{
+		std::lock_guard<std::mutex> lock(sparesMutex());
+		if(!spares().empty()){
+			cache=spares().back();
+			spares().pop_back();
+		}
+	}
+
+	if(!cache){
+		cache=new std::vector<MemPool>;
+		makePools(*cache);
+	}
+
+	// past its thread_local destructors the thread keeps the cache
+	if(!s_cacheGone){
+		static thread_local CacheHolder holder;
+		(void)holder;
+	}
+
+	s_cache=cache;
+	return *cache;
+}
+
+//--------------------------------------------------------------------
+
+inline size_t Small_Object_Allocator::trim()
+{
+	size_t released=0;
+	if(std::vector<MemPool>* cache=s_cache){
+		released+=trim(*cache);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(sparesMutex());
+		for(auto cache : spares()){
+			released+=trim(*cache);
+		}
+	}
+
+#ifdef __GLIBC__
+	// the chunks go back to malloc, which keeps them unless asked
+	if(released>0){
+		malloc_trim(0);
+	}
+#endif
+
+	return released;
+}
+
+//--------------------------------------------------------------------
+
+inline std::vector<MemPool::Stats> Small_Object_Allocator::stats()
+{
+	std::vector<MemPool::Stats> total;
+	auto add=[&total](std::vector<MemPool>& allocators){
+		total.resize(allocators.size());
+		for(size_t i=0; i<allocators.size(); i++){
+			MemPool::Stats stats=allocators[i].stats();
+			total[i].m_blockSize=stats.m_blockSize;
+			total[i].m_liveBlocks+=stats.m_liveBlocks;
+			total[i].m_freeBlocks+=stats.m_freeBlocks;
+			total[i].m_chunks+=stats.m_chunks;
+			total[i].m_peakChunks+=stats.m_peakChunks;
+		}
+	};
+
+	add(pools());
+
+	std::lock_guard<std::mutex> lock(sparesMutex());
+	for(auto cache : spares()){
+		add(*cache);
+	}
+
+	return total;
 }
 
 //--------------------------------------------------------------------
@@ -199,13 +948,16 @@ inline void Small_Object_Allocator::free(T* p)
 inline void* Small_Object_Allocator::allocate(std::size_t block_size)
 {
 	if(block_size>c_max_object_size){
+		if(Arena* arena=s_arena){
+			return arena->allocateLarge(block_size);
+		}
 		return ::operator new(block_size);
 	}
 
 	size_t idx=0;
 	while(block_size>(size_t(CHUNK_SIZE)<<(idx++)));
 
-	return m_allocators[idx-1].allocateMem();
+	return pools()[idx-1].allocateMem();
 }
 
 //--------------------------------------------------------------------
@@ -213,14 +965,30 @@ inline void* Small_Object_Allocator::allocate(std::size_t block_size)
 inline void Small_Object_Allocator::deallocate(void* p, std::size_t block_size)
 {
 	if(block_size>c_max_object_size){
+		if(Arena* arena=s_arena){
+			arena->freeLarge(p);
+			return;
+		}
 		::operator delete(p);
 		return;
 	}
 	
 	size_t idx=0;
 	while(block_size>(size_t(CHUNK_SIZE)<<(idx++)));
-	
-	m_allocators[idx-1].freeMem(p);
+
+	if(std::vector<MemPool>* threadAllocators=s_threadAllocators){
+		(*threadAllocators)[idx-1].freeMem(p);
+		return;
+	}
+
+	MemPool* owner=MemPool::ownerOf(p);
+	std::vector<MemPool>* cache=s_cache;
+	if(cache && owner==&(*cache)[idx-1]){
+		owner->freeMem(p);
+	}
+	else{
+		owner->freeRemote(p);
+	}
 }
 
 //====================================================================
@@ -0,0 +1,222 @@
+/*********************************************************************
+* StructuralIndex class                        								*
+*                                                                    *
+* Version: 1.0                                                       *
+* Date:    17-10-2026                                                *
+* Author:  Dan Machado                                               *                                         *
+**********************************************************************/
+#ifndef STRUCTURAL_INDEX_H
+#define STRUCTURAL_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+
+//====================================================================
+
+namespace easyjson
+{
+namespace internal
+{
+
+/*
+ * Stage 1 of the parser: the buffer is classified 64 bytes at a time
+ * (AVX2, SSE or plain C++, depending on the target) and the position
+ * of every structural character outside of strings ({ } [ ] : ,),
+ * every unescaped quote and the first byte of every scalar (number,
+ * true, false, null...) is recorded.
+ *
+ * Stage 2 (JsonParser::parserLoop) pulls the positions one by one,
+ * so whitespace and string contents are never visited byte by byte.
+ * The index is filled in small windows that stay in L1 while stage 2
+ * consumes them.
+ *
+ * A closing quote is flagged with c_DIRTY when the string contains
+ * a backslash or a control character and therefore has to go through
+ * the slow path that validates and compacts escape sequences.
+ * Positions are the 31 bits left, the input cannot be longer than
+ * c_MAX_LENGTH: the parser checks it before indexing.
+ *
+ * When streaming, the buffer grows between calls (extend) and only
+ * the positions up to the last structural character outside of a
+ * string are handed out: every string and every scalar before it is
+ * complete, so stage 2 never stops in the middle of a token. The rest
+ * is held back until more data arrives or setFinal() is called.
+ *
+ * With validateUTF8() every block is also checked to be valid UTF-8
+ * while it is classified (ParseOptions::m_strictUTF8). Indexing stops
+ * at the first invalid sequence: only the positions before it are
+ * handed out and utf8Error() tells where it starts.
+ * */
+class StructuralIndex final
+{
+	public:
+		static constexpr uint32_t c_END=uint32_t(-1);
+		static constexpr uint32_t c_DIRTY=uint32_t(1)<<31;
+		static constexpr size_t c_MAX_LENGTH=size_t(c_DIRTY)-1; // positions take the 31 bits below c_DIRTY
+		static constexpr size_t c_VALID=size_t(-1);
+
+		StructuralIndex(const char* buffer, size_t length, bool streaming=false)
+		: m_buffer(buffer)
+		, m_length(length)
+		, m_streaming(streaming)
+		{
+		}
+
+		~StructuralIndex()=default;
+
+		uint32_t next() __attribute__((always_inline)) __attribute__((hot))
+		{
+			if(m_current==m_count){
+				if(!refill()){
+					return c_END;
+				}
+			}
+			return m_entries[m_current++];
+		}
+
+		// the buffer may have been reallocated
+		void extend(const char* buffer, size_t length)
+		{
+			m_buffer=buffer;
+			m_length=length;
+		}
+
+		void setFinal()
+		{
+			m_streaming=false;
+		}
+
+		// a new buffer, as if the index had just been made for it
+		void reset(const char* buffer, size_t length)
+		{
+			extend(buffer, length);
+			skipTo(0);
+			m_streaming=false;
+			m_safeEnd=0;
+			m_validateUTF8=false;
+			m_utf8Error=c_VALID;
+		}
+
+		void validateUTF8()
+		{
+			m_validateUTF8=true;
+		}
+
+		// offset of the first invalid UTF-8 sequence or c_VALID
+		size_t utf8Error() const
+		{
+			return m_utf8Error;
+		}
+
+		/*
+		 * Carries on from position, which has to be outside of any
+		 * string (i.e. right after a closing bracket): what was indexed
+		 * before is dropped and the next block starts there.
+		 * */
+		void skipTo(size_t position)
+		{
+			m_position=position;
+			m_count=0;
+			m_current=0;
+			m_indexed=0;
+			m_prevInString=0;
+			m_prevEscaped=0;
+			m_prevScalar=0;
+			m_dirtyString=false;
+			m_utf8Tail=0;
+		}
+
+		/*
+		 * Bytes that are neither whitespace nor structural are part
+		 * of a scalar, the index only records where a scalar starts.
+		 * Notice that as in the original parser anything below 33
+		 * (signed char) counts as whitespace, '\0' included, while
+		 * inside a string a '\0' is an invalid control character.
+		 * */
+		static bool isScalarByte(char c) __attribute__((always_inline))
+		{
+			switch(c){
+				case '{':
+				case '}':
+				case '[':
+				case ']':
+				case ':':
+				case ',':
+				case '"':
+					return false;
+				default:
+					return c>32;
+			}
+		}
+
+	private:
+		static constexpr size_t c_BLOCK=64;
+		static constexpr size_t c_WINDOW=32; // blocks per refill
+
+		const char* m_buffer;
+		size_t m_length;
+		size_t m_position{0};
+		bool m_streaming;
+		size_t m_safeEnd{0}; // one past the last operator outside of a string
+		uint32_t m_indexed{0}; // when streaming, entries after m_count are held back
+
+		uint64_t m_prevInString{0};
+		uint64_t m_prevEscaped{0};
+		uint64_t m_prevScalar{0};
+		bool m_dirtyString{false};
+
+		bool m_validateUTF8{false};
+		uint32_t m_utf8Tail{0}; // last bytes of the previous block, a sequence may go on in the next one
+		size_t m_utf8Error{c_VALID};
+
+		uint32_t m_count{0};
+		uint32_t m_current{0};
+		uint32_t m_entries[c_WINDOW*c_BLOCK];
+
+		bool refill();
+		bool refillStream();
+		void indexBlock(const char* block, uint32_t offset) __attribute__((hot));
+		void finishUTF8();
+
+		StructuralIndex(const StructuralIndex&)=delete;
+		StructuralIndex& operator=(const StructuralIndex&)=delete;
+};
+
+//====================================================================
+
+/*
+ * Position of the first backslash or control character in
+ * [first, last), or last if there is none. Used to jump over the
+ * plain runs of a string that holds escape sequences.
+ * */
+const char* findEscapeOrControl(const char* first, const char* last) __attribute__((hot));
+
+//====================================================================
+
+/*
+ * Pre-scan of a document split among threads: whether [first, last)
+ * holds an odd number of (unescaped) quotes and how much the nesting
+ * of brackets changes across it, for both cases, the range starting
+ * outside ([0]) or inside ([1]) of a string.
+ * */
+struct RangeSummary
+{
+	bool m_oddQuotes{false};
+	int64_t m_depth[2]{0, 0};
+};
+
+RangeSummary summarizeRange(const char* buffer, size_t first, size_t last);
+
+/*
+ * Position of the first ',' in [first, last) that is outside of
+ * strings at depth 1 (between two items of the top level array),
+ * given the state at first. last if there is none.
+ * */
+size_t findSeparator(const char* buffer, size_t first, size_t last, bool inString, int64_t depth);
+
+//====================================================================
+
+}//internal
+} // easyjson namespace
+
+#endif
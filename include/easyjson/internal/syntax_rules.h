@@ -0,0 +1,286 @@
+/*********************************************************************
+* SyntaxRules class                            								*
+* scanScalar                                                         *
+*                                                                    *
+* Version: 1.0                                                       *
+* Date:    17-10-2026                                                *
+* Author:  Dan Machado                                               *                                         *
+**********************************************************************/
+#ifndef SYNTAX_RULES_H
+#define SYNTAX_RULES_H
+
+#include "easyjson/internal/json_utilities.h"
+
+//====================================================================
+
+namespace easyjson
+{
+namespace internal
+{
+
+/*
+ * What the parser accepts next, shared by the document parser
+ * (JsonParser::parseEntries) and the event parser (JsonSax).
+ * */
+class SyntaxRules
+{
+	public:
+		void setRuleInitial() __attribute__((always_inline))
+		{
+			m_rule=Rule::initial;
+		}
+
+		bool syntaxRuleInitial() __attribute__((always_inline))
+		{
+			return m_rule==Rule::initial;
+		}
+
+		void setRuleKey() __attribute__((always_inline))
+		{
+			m_rule=Rule::key;
+		}
+
+		bool syntaxRuleKey() __attribute__((always_inline))
+		{
+			return m_rule & Rule::key;
+		}
+
+		void setRuleObj() __attribute__((always_inline))
+		{
+			m_rule=Rule::obj;
+		}
+
+		bool syntaxRuleObj() __attribute__((always_inline))
+		{
+			return (m_rule & Rule::ready) | (m_rule & Rule::curl);
+		}
+
+		void setRuleArr() __attribute__((always_inline))
+		{
+			m_rule=Rule::arr;
+		}
+
+		bool syntaxRuleArr() __attribute__((always_inline))
+		{
+			return (m_rule & Rule::ready) | (m_rule & Rule::squrt);
+		}
+
+		void setRuleValue() __attribute__((always_inline))
+		{
+			m_rule=Rule::value;
+		}
+
+		bool syntaxRuleValue() __attribute__((always_inline))
+		{
+			return m_rule & Rule::value;
+		}
+
+		void setRuleReady(bool factor=true) __attribute__((always_inline))
+		{
+			m_rule=Rule::closing;
+			if(factor){
+				m_rule=Rule::ready;
+			}
+		}
+
+		bool syntaxRuleReady() __attribute__((always_inline))
+		{
+			return m_rule & Rule::ready;
+		}
+
+		void setRuleComma() __attribute__((always_inline))
+		{
+			m_rule=Rule::comma;
+		}
+
+		bool syntaxRuleComma() __attribute__((always_inline))
+		{
+			return m_rule==Rule::comma;
+		}
+
+		void setRuleColon() __attribute__((always_inline))
+		{
+			m_rule=Rule::colon;
+		}
+
+		bool syntaxRuleColon() __attribute__((always_inline))
+		{
+			return m_rule==Rule::colon;
+		}
+
+		/*bool syntaxRuleValueInitial() __attribute__((always_inline))
+		{
+			return m_rule & (Rule::value | Rule::initial);
+		}*/
+
+	private:
+		enum Rule : unsigned char
+		{
+			closing=0,
+			initial=1,
+			value=1<<1,
+			ready=1<<2,
+			curl=1<<3,
+			squrt=1<<4,
+			key=1<<5,
+			obj=(curl | key),
+			arr=(squrt | value),
+			comma=1<<6,
+			colon=1<<7,
+		};
+
+		Rule m_rule{Rule::initial};
+};
+
+//====================================================================
+
+struct NumFormat
+{
+	enum : unsigned char
+	{
+		none=0,
+		neg=1,
+		pst=1<<1,
+		dots=1<<2,
+		eCount=1<<3,
+		bad=neg | pst,
+		bad2=eCount | neg | pst,
+	};
+};
+
+/*
+ * Validates the scalar (number, true, false or null) starting at
+ * cstr and returns the position of its last byte, or -1 with the
+ * error in errorCode. The input is not modified: the byte after the
+ * scalar is a delimiter, whitespace or '\0' and it is up to the
+ * caller to terminate the value there.
+ * */
+inline int scanScalar(const char* cstr, JSON_TYPES& type, ErrorCode& errorCode) __attribute__((always_inline));
+
+inline int scanScalar(const char* cstr, JSON_TYPES& type, ErrorCode& errorCode)
+{
+	if(cstr[0]!='-' && (int(cstr[0])<48 || int(cstr[0])>57)){
+		size_t k=0;
+		bool a=true;
+		if(cstr[0]=='n'){
+			k=4;
+			a=cstr[1]=='u' && cstr[2]=='l' && cstr[3]=='l';
+			type=JSON_TYPES::_NULL;
+		}
+		else if(cstr[0]=='t'){
+			k=4;
+			a=cstr[1]=='r' && cstr[2]=='u' && cstr[3]=='e';
+			type=JSON_TYPES::_BOOL;
+		}
+		else if(cstr[0]=='f'){
+			k=5;
+			a=cstr[1]=='a' && cstr[2]=='l' && cstr[3]=='s' && cstr[4]=='e';
+			type=JSON_TYPES::_BOOL;
+		}
+		else{ //k==0
+			errorCode=ErrorCode::error1;
+			return -1;
+		}
+
+		// cstr[k] is only safe to read once the literal has matched
+		if(!a || cstr[k]==0){
+			errorCode=ErrorCode::error1;
+			return -1;
+		}
+
+		return k-1;
+	}
+
+	// Leading zeroes
+	// notice that cstr[1] is valid since it could be '\0'
+	if(cstr[0]==48 && (cstr[1]==48 || cstr[1]=='e' || cstr[1]=='E')){
+		errorCode=ErrorCode::error5;
+		return -1;
+	}
+
+	type=JSON_TYPES::_NUM;
+
+	unsigned char format=0;
+
+	size_t i=0;
+
+	if(cstr[i]=='-'){
+		format=NumFormat::neg;
+		i++;
+	}
+
+	i--; // !!
+	while(true){
+		while(cstr[++i]>47 && cstr[i]<58);// ;-)
+
+		if(cstr[i]==',' || cstr[i]=='}' || cstr[i]==']'){
+			break;
+		}
+
+		if(int(cstr[i])<33){// As we are parsing a numeric value, we don't need to check for specific white characters
+			break;
+		}
+
+		if(cstr[i]=='-'){
+			if(format & NumFormat::bad){
+				errorCode=ErrorCode::error5;
+				return -1;
+			}
+			format=format|NumFormat::neg;
+			continue;
+		}
+
+		if(cstr[i]=='+'){
+			if(0==(format & NumFormat::eCount) || format & NumFormat::bad){
+				errorCode=ErrorCode::error5;
+				return -1;
+			}
+			format=format|NumFormat::pst;
+			continue;
+		}
+
+		if(cstr[i]=='e' || cstr[i]=='E'){
+			if(format & NumFormat::eCount){
+				errorCode=ErrorCode::error5;
+				return -1;
+			}
+			format=format&~NumFormat::neg;
+			format=format | NumFormat::eCount | NumFormat::dots;// dots are not allowed after e/E
+			continue;
+		}
+
+		if(cstr[i]=='.'){
+			if(format & NumFormat::dots){
+				errorCode=ErrorCode::error5;
+				return -1;
+			}
+			format=format|NumFormat::dots;
+			type=JSON_TYPES::_DOUBLE;
+			continue;
+		}
+
+		errorCode=ErrorCode::error5;
+		return -1;
+	}
+
+	if(format & NumFormat::eCount){
+		if(cstr[i-1]=='e' || cstr[i-1]=='E'){
+			errorCode=ErrorCode::error5;
+			return -1;
+		}
+	}
+
+	if(cstr[i-1]=='.'){
+		errorCode=ErrorCode::error6;
+		return -1;
+	}
+
+	return i-1;
+}
+
+//====================================================================
+
+}//internal
+} // easyjson namespace
+
+#endif
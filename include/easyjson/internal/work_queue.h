@@ -0,0 +1,125 @@
+/*********************************************************************
+* WorkQueue class                              								*
+*                                                                    *
+* Version: 1.0                                                       *
+* Date:    17-10-2026                                                *
+* Author:  Dan Machado                                               *                                         *
+**********************************************************************/
+#ifndef WORK_QUEUE_H
+#define WORK_QUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+//====================================================================
+
+namespace easyjson
+{
+namespace internal
+{
+
+/*
+ * Work stealing over the indices [0, count), count below 2^32: every
+ * worker starts with an equal, contiguous range and takes its indices
+ * from the front. Once it runs out, it steals the back half of the
+ * largest range left and carries on with it, so a worker that got the
+ * expensive items does not hold the others back.
+ *
+ * A range is a single atomic word (first<<32 | last): it only shrinks
+ * until its owner refills it, and the owner refills it only when it is
+ * empty, so a stale value never compares equal.
+ * */
+class WorkQueue final
+{
+	public:
+		WorkQueue(size_t count, unsigned workers)
+		: m_ranges(new Range[workers])
+		, m_workers(workers)
+		{
+			for(unsigned t=0; t<workers; t++){
+				m_ranges[t].m_bounds.store(pack(count*t/workers, count*(t+1)/workers), std::memory_order_relaxed);
+			}
+		}
+
+		~WorkQueue()=default;
+
+		// false once every index has been taken
+		bool next(unsigned worker, size_t& idx)
+		{
+			std::atomic<uint64_t>& own=m_ranges[worker].m_bounds;
+
+			uint64_t bounds=own.load(std::memory_order_acquire);
+			while(first(bounds)<last(bounds)){
+				if(own.compare_exchange_weak(bounds, pack(first(bounds)+1, last(bounds)), std::memory_order_acq_rel)){
+					idx=first(bounds);
+					return true;
+				}
+			}
+
+			return steal(own, idx);
+		}
+
+	private:
+		struct alignas(64) Range
+		{
+			std::atomic<uint64_t> m_bounds{0};
+		};
+
+		std::unique_ptr<Range[]> m_ranges;
+		const unsigned m_workers;
+
+		static uint64_t pack(uint64_t first, uint64_t last) __attribute__((always_inline))
+		{
+			return (first<<32) | last;
+		}
+
+		static size_t first(uint64_t bounds) __attribute__((always_inline))
+		{
+			return size_t(bounds>>32);
+		}
+
+		static size_t last(uint64_t bounds) __attribute__((always_inline))
+		{
+			return size_t(bounds & 0xFFFFFFFF);
+		}
+
+		bool steal(std::atomic<uint64_t>& own, size_t& idx)
+		{
+			while(true){
+				std::atomic<uint64_t>* victim=nullptr;
+				uint64_t bounds=0;
+				size_t largest=0;
+				for(unsigned t=0; t<m_workers; t++){
+					uint64_t tmp=m_ranges[t].m_bounds.load(std::memory_order_acquire);
+					if(last(tmp)-first(tmp)>largest){
+						largest=last(tmp)-first(tmp);
+						victim=&m_ranges[t].m_bounds;
+						bounds=tmp;
+					}
+				}
+
+				if(!victim){
+					return false;
+				}
+
+				size_t cut=last(bounds)-(largest+1)/2;
+				if(victim->compare_exchange_strong(bounds, pack(first(bounds), cut), std::memory_order_acq_rel)){
+					idx=cut;
+					own.store(pack(cut+1, last(bounds)), std::memory_order_release);
+					return true;
+				}
+			}
+		}
+
+		WorkQueue(const WorkQueue&)=delete;
+		WorkQueue& operator=(const WorkQueue&)=delete;
+};
+
+//====================================================================
+
+}//internal
+} // easyjson namespace
+
+#endif
@@ -7,6 +7,18 @@
 #include "easyjson/easyjson.h"
 #include "easyjson/internal/json_utilities.h"
 #include "easyjson/internal/json_core.h"
+#include "easyjson/internal/structural_index.h"
+#include "easyjson/internal/syntax_rules.h"
+#include "easyjson/internal/event_parser.h"
+#include "easyjson/internal/work_queue.h"
+#include "easyjson/easyjson_sax.h"
+
+#include <latch>
+#include <mutex>
+#include <charconv>
+#include <thread>
+#include <algorithm>
+#include <exception>
 
 namespace easyjson
 {
@@ -29,7 +41,7 @@ void setData(const JsonValue& jsonValue, NodeJson* node, JsonObjBuffer& jsonBuff
 
 void setData(const JsonPair& jsonPair, NodeJson* node, JsonObjBuffer& jsonBuffer)
 {
-	node->setData(jsonBuffer, jsonPair.m_key, JSON_TYPES::_STR);
+	node->setKey(jsonBuffer, jsonPair.m_key);
 	node=node->addChild();
 	
 	if(JSON_TYPES::_JSON_ARRAY==jsonPair.m_modifier){
@@ -138,6 +150,22 @@ class JsonImpl
 
 		const char* getRawData() const;
 
+		JSON_TYPES getDecoded(int64_t& integer, double& real) const
+		{
+			if(!m_node || !m_node->isDecoded()){
+				return JSON_TYPES::_NA;
+			}
+
+			if(m_node->getDataMode()==JSON_TYPES::_INT){
+				integer=m_node->getInteger();
+			}
+			else{
+				real=m_node->getReal();
+			}
+
+			return m_node->getDataMode();
+		}
+
 		void removeKey(const char* key);
 		
 		void removeKey(const char8_t* key)
@@ -169,15 +197,24 @@ class JsonImpl
 
 		std::string toString(bool prettyStr=false) const;
 
+		// a lazy scope that could not be parsed invalidates the whole document
 		bool isValid() const
 		{
-			return m_errorHandler.isValid();
+			return m_errorHandler.isValid() && (!m_jsonBufferPtr || m_jsonBufferPtr->m_scopeError==ErrorCode::error0);
 		}
 
 		std::string getErrorMsg() const
 		{
+			if(m_errorHandler.isValid() && m_jsonBufferPtr){
+				return ErrorReporting::getErrorMsg(m_jsonBufferPtr->m_scopeError);
+			}
 			return m_errorHandler.getErrorMsg();
 		}
+
+		size_t getErrorPosition() const
+		{
+			return m_errorHandler.getPosition();
+		}
 		
 		bool isString() const
 		{
@@ -196,6 +233,8 @@ class JsonImpl
 		
 		size_t size() const;
 
+		JsonDocumentStats memoryStats() const;
+
 	private:
 		JsonObjBuffer* m_jsonBufferPtr;
 		NodeJson* m_node;
@@ -213,7 +252,9 @@ class JsonImpl
 			other.m_isRoot=false;
 		}
 
-		explicit JsonImpl(const char* data, ErrorHandlerMode mode=ErrorHandlerMode::Exception);
+		JsonImpl(const char* data, size_t length, ErrorHandlerMode mode=ErrorHandlerMode::Exception);
+		JsonImpl(char* data, size_t length, in_situ, ErrorHandlerMode mode=ErrorHandlerMode::Exception);
+		JsonImpl(JsonObjBuffer* jsonBufferPtr, ErrorHandlerMode mode);
 		explicit JsonImpl(size_t bufferSize, ErrorHandlerMode mode=ErrorHandlerMode::Exception);
 
 		JsonImpl(NodeJson* node, JsonObjBuffer* jsonBufferPtr, ErrorHandlerMode mode=ErrorHandlerMode::Exception) __attribute__((always_inline))
@@ -225,6 +266,9 @@ class JsonImpl
 			if(!node){
 				m_errorHandler.setError(ErrorCode::error20);
 			}
+			else if(node->isLazy()){
+				materialize();
+			}
 		}
 
 		explicit JsonImpl(ErrorHandlerMode mode);
@@ -240,6 +284,9 @@ class JsonImpl
 
 		NodeJson* nodeAt(uint idx) const __attribute__((always_inline));
 
+		// parses the scope of a lazy node, the scopes nested in it stay lazy
+		void materialize();
+
 		template<typename T, typename FUNC>
 		void initArray(std::initializer_list<T>&& list, FUNC cbk);
 		
@@ -252,6 +299,12 @@ class JsonImpl
 		
 		bool failWhen(bool a, ErrorCode errorCode) const	__attribute__((always_inline));
 
+		// for the methods that allocate or free nodes, see ParseOptions::m_arena
+		Allocator::Small_Object_Allocator::Arena::Scope arenaScope() const __attribute__((always_inline))
+		{
+			return Allocator::Small_Object_Allocator::Arena::Scope(m_jsonBufferPtr? m_jsonBufferPtr->arena() : nullptr);
+		}
+
 	friend JsonParser;
 };
 
@@ -260,150 +313,143 @@ class JsonImpl
 class JsonParser
 {
 	public:
-		static JsonImpl* parse(const char* str, ErrorHandlerMode mode=ErrorHandlerMode::Exception)
+		static JsonImpl* parse(const char* str, size_t length, ErrorHandlerMode mode=ErrorHandlerMode::Exception)
 		{
-			JsonImpl* JsonImplPtr=new JsonImpl(str, mode);
+			JsonImpl* JsonImplPtr=new JsonImpl(str, length, mode);
 
 			parserLoop(JsonImplPtr->m_jsonBufferPtr, JsonImplPtr->m_node, JsonImplPtr->m_errorHandler);
 
 			return JsonImplPtr;
 		}
 
-		static JsonImpl* initObj(ErrorHandlerMode mode=ErrorHandlerMode::Exception)
+		static JsonImpl* parse(const char* str, ErrorHandlerMode mode=ErrorHandlerMode::Exception)
 		{
-			return new JsonImpl(mode);
+			return parse(str, std::strlen(str), mode);
 		}
-		
-		static JsonImpl* parse(const char8_t* str, ErrorHandlerMode mode=ErrorHandlerMode::Exception)
+
+		static JsonImpl* parse(const char* str, size_t length, const ParseOptions& options, ErrorHandlerMode mode=ErrorHandlerMode::Exception)
 		{
-			return parse(reinterpret_cast<const char*>(str), mode);
+			JsonImpl* JsonImplPtr=new JsonImpl(str, length, mode);
+
+			Allocator::Small_Object_Allocator::Arena* arena=nullptr;
+			if(options.m_arena){
+				// the root as well, so nothing of the document is left in the process pools
+				arena=JsonImplPtr->m_jsonBufferPtr->useArena();
+				NodeJson::freeNode(JsonImplPtr->m_node);
+			}
+			Allocator::Small_Object_Allocator::Arena::Scope scope(arena);
+			if(arena){
+				JsonImplPtr->m_node=NodeJson::allocateNode();
+				JsonImplPtr->m_node->setAsObj();
+			}
+
+			parserLoop(JsonImplPtr->m_jsonBufferPtr, JsonImplPtr->m_node, JsonImplPtr->m_errorHandler, options);
+
+			return JsonImplPtr;
 		}
 
-		static JsonImpl* openJsonFile(const char* jsonFileName, ErrorHandlerMode mode=ErrorHandlerMode::Exception);
-		
-		static std::string utf8Encode(const char* cstr);
+		static JsonImpl* parse(const char* str, size_t length, unsigned threadCount, ErrorHandlerMode mode=ErrorHandlerMode::Exception)
+		{
+			JsonImpl* JsonImplPtr=new JsonImpl(str, length, mode);
 
-	private:	
+			parallelLoop(JsonImplPtr->m_jsonBufferPtr, JsonImplPtr->m_node, JsonImplPtr->m_errorHandler, threadCount);
 
-		class SyntaxRules
+			return JsonImplPtr;
+		}
+
+		static JsonImpl* parseInSitu(char* buffer, size_t length, ErrorHandlerMode mode=ErrorHandlerMode::Exception)
 		{
-			public:
-				void setRuleInitial() __attribute__((always_inline))
-				{
-					m_rule=Rule::initial;
-				}
+			JsonImpl* JsonImplPtr=new JsonImpl(buffer, length, in_situ(), mode);
 
-				bool syntaxRuleInitial() __attribute__((always_inline))
-				{
-					return m_rule==Rule::initial;
-				}
+			parserLoop(JsonImplPtr->m_jsonBufferPtr, JsonImplPtr->m_node, JsonImplPtr->m_errorHandler);
 
-				void setRuleKey() __attribute__((always_inline))
-				{
-					m_rule=Rule::key;
-				}
+			return JsonImplPtr;
+		}
 
-				bool syntaxRuleKey() __attribute__((always_inline))
-				{
-					return m_rule & Rule::key;
-				}
+		static JsonImpl* parseLazy(const char* str, size_t length, ErrorHandlerMode mode=ErrorHandlerMode::Exception)
+		{
+			JsonImpl* JsonImplPtr=new JsonImpl(str, length, mode);
 
-				void setRuleObj() __attribute__((always_inline))
-				{
-					m_rule=Rule::obj;
-				}
+			lazyLoop(JsonImplPtr->m_jsonBufferPtr, JsonImplPtr->m_node, JsonImplPtr->m_errorHandler);
 
-				bool syntaxRuleObj() __attribute__((always_inline))
-				{
-					return (m_rule & Rule::ready) | (m_rule & Rule::curl);
-				}
+			return JsonImplPtr;
+		}
 
-				void setRuleArr() __attribute__((always_inline))
-				{
-					m_rule=Rule::arr;
-				}
+		static JsonImpl* parseProjected(const char* str, size_t length, std::span<const std::string_view> paths, ErrorHandlerMode mode=ErrorHandlerMode::Exception)
+		{
+			JsonImpl* JsonImplPtr=new JsonImpl(str, length, mode);
 
-				bool syntaxRuleArr() __attribute__((always_inline))
-				{
-					return (m_rule & Rule::ready) | (m_rule & Rule::squrt);
-				}
+			projectionLoop(JsonImplPtr->m_jsonBufferPtr, JsonImplPtr->m_node, JsonImplPtr->m_errorHandler, paths);
 
-				void setRuleValue() __attribute__((always_inline))
-				{
-					m_rule=Rule::value;
-				}
+			return JsonImplPtr;
+		}
 
-				bool syntaxRuleValue() __attribute__((always_inline))
-				{
-					return m_rule & Rule::value;
-				}
+		// the documents in the same order, see JsonObj::parseMany
+		static std::vector<JsonImpl*> parseMany(std::span<const std::string_view> documents, unsigned threadCount, ErrorHandlerMode mode);
 
-				void setRuleReady(bool factor=true) __attribute__((always_inline))
-				{
-					m_rule=Rule::closing;
-					if(factor){
-						m_rule=Rule::ready;
-					}
-				}
+		static JsonImpl* initObj(ErrorHandlerMode mode=ErrorHandlerMode::Exception)
+		{
+			return new JsonImpl(mode);
+		}
+		
+		static JsonImpl* parse(const char8_t* str, ErrorHandlerMode mode=ErrorHandlerMode::Exception)
+		{
+			return parse(reinterpret_cast<const char*>(str), mode);
+		}
 
-				bool syntaxRuleReady() __attribute__((always_inline))
-				{
-					return m_rule & Rule::ready;
-				}
+		static JsonImpl* openJsonFile(const char* jsonFileName, ErrorHandlerMode mode=ErrorHandlerMode::Exception, unsigned threadCount=1);
 
-				void setRuleComma() __attribute__((always_inline))
-				{
-					m_rule=Rule::comma;
-				}
+		// the file content, mapped or read, without parsing it, error28 past maxLength
+		static JsonImpl* loadJsonFile(const char* jsonFileName, ErrorHandlerMode mode=ErrorHandlerMode::Exception, bool writable=true, size_t maxLength=size_t(-1));
+		
+		static std::string utf8Encode(const char* cstr);
 
-				bool syntaxRuleComma() __attribute__((always_inline))
-				{
-					return m_rule==Rule::comma;
-				}
+		// JSON Lines, fileImplPtr holds the unparsed file (loadJsonFile)
+		static size_t fileLength(JsonImpl* fileImplPtr);
+		static size_t lineStart(JsonImpl* fileImplPtr, size_t position);
+		static size_t countLines(JsonImpl* fileImplPtr, size_t first, size_t last);
+		static bool nextLine(JsonImpl* fileImplPtr, size_t& position, size_t last, const char*& line, size_t& length);
+		static void parseLine(JsonImpl* JsonImplPtr, const char* line, size_t length);
 
-				void setRuleColon() __attribute__((always_inline))
-				{
-					m_rule=Rule::colon;
-				}
+		static ParserContext* openStream(JsonImpl* JsonImplPtr);
+		static void parseChunk(JsonImpl* JsonImplPtr, ParserContext* context, const char* chunk, size_t length);
+		static void closeStream(JsonImpl* JsonImplPtr, ParserContext* context);
 
-				bool syntaxRuleColon() __attribute__((always_inline))
-				{
-					return m_rule==Rule::colon;
-				}
-				
-				/*bool syntaxRuleValueInitial() __attribute__((always_inline))
-				{
-					return m_rule & (Rule::value | Rule::initial);
-				}*/
+		// JsonReusableParser, the context is kept from one document to the next
+		static ParserContext* openContext(JsonImpl* JsonImplPtr);
+		static void reparse(JsonImpl* JsonImplPtr, ParserContext* context, const char* str, size_t length, const ParseOptions& options);
+		static void closeContext(JsonImpl* JsonImplPtr, ParserContext* context);
 
-			private:
-				enum Rule : unsigned char
-				{
-					closing=0,
-					initial=1,
-					value=1<<1,
-					ready=1<<2,
-					curl=1<<3,
-					squrt=1<<4,
-					key=1<<5,
-					obj=(curl | key),
-					arr=(squrt | value),
-					comma=1<<6,
-					colon=1<<7,
-				};
-				
-				Rule m_rule{Rule::initial};
-		};
+	private:	
 
-		static void parserLoop(JsonObjBuffer* jsonObjBuffer, NodeJson* node, ErrorReporting& errorHandler);
+		using SyntaxRules=internal::SyntaxRules;
+
+		static void parserLoop(JsonObjBuffer* jsonObjBuffer, NodeJson* node, ErrorReporting& errorHandler, const ParseOptions& options=ParseOptions());
+		static JsonImpl* parseDocument(std::string_view document, ErrorHandlerMode mode);
+		static void parallelLoop(JsonObjBuffer* jsonObjBuffer, NodeJson* node, ErrorReporting& errorHandler, unsigned threadCount);
+		static ErrorCode parseItems(JsonObjBuffer& jsonObjBuffer, NodeJson* node, size_t first, size_t last, bool final, bool trailingScalar, size_t end, size_t& position);
+		static size_t inputLength(JsonObjBuffer* jsonObjBuffer, bool& trailingScalar, size_t& end);
+		static size_t inputEnd(const char* buffer, size_t length);
+		static bool tooLarge(size_t length, ErrorReporting& errorHandler) __attribute__((always_inline));
+		static void lazyLoop(JsonObjBuffer* jsonObjBuffer, NodeJson* node, ErrorReporting& errorHandler);
+		static void projectionLoop(JsonObjBuffer* jsonObjBuffer, NodeJson* node, ErrorReporting& errorHandler, std::span<const std::string_view> paths);
+		static void parseScope(JsonObjBuffer* jsonObjBuffer, NodeJson* node, ErrorReporting& errorHandler);
+		static void parseEntries(ParserContext& context, ErrorReporting& errorHandler);
+		static void finishParsing(ParserContext& context, ErrorReporting& errorHandler);
+		static void streamPosition(const ParserContext& context, ErrorReporting& errorHandler);
+		static ErrorCode trailingScalarError(ParserContext& context, size_t& first);
 
 		JsonParser()=delete;
 
 		static int parseSpecial(char* cstr, ErrorReporting& errorHandler, NodeJson* node);
 		static int parseNumeric(char* cstr, ErrorReporting& errorHandler, NodeJson* node);
 
-		static int parseValueData(char* cstr, ErrorReporting& errorHandler, NodeJson* node);
+		static int parseValueData(char* cstr, ErrorReporting& errorHandler, NodeJson* node, bool decodeNumbers);
+		static void decodeNumber(const char* first, const char* last, JSON_TYPES type, NodeJson* node);
 		static void removeEmptyIndex(NodeJson* node);
+
+	friend class ParserContext;
+	friend class JsonImpl;
 };
 
 //--------------------------------------------------------------------
@@ -415,7 +461,7 @@ void JsonParser::removeEmptyIndex(NodeJson* node)
 	 * */
 
 	//if(node->isArray()){// we already check that it is an array
-	NodeJson::VectWrapper* vectPtr=reinterpret_cast<NodeJson::VectWrapper*>(node->m_child);
+	NodeJson::VectWrapper* vectPtr=node->vect();
 
 	if(vectPtr->size()==1){
 		NodeJson* item=vectPtr->getLast();
@@ -431,8 +477,30 @@ void JsonParser::removeEmptyIndex(NodeJson* node)
 
 //--------------------------------------------------------------------
 
-inline JsonImpl::JsonImpl(const char* data, ErrorHandlerMode mode)
-: m_jsonBufferPtr(new JsonObjBuffer(data))
+inline JsonImpl::JsonImpl(const char* data, size_t length, ErrorHandlerMode mode)
+: m_jsonBufferPtr(new JsonObjBuffer(data, length))
+, m_node(NodeJson::allocateNode())
+, m_errorHandler(mode)
+, m_isRoot(true)
+{
+	m_node->setAsObj();
+}
+
+//--------------------------------------------------------------------
+
+inline JsonImpl::JsonImpl(char* data, size_t length, in_situ, ErrorHandlerMode mode)
+: m_jsonBufferPtr(new JsonObjBuffer(data, length, in_situ()))
+, m_node(NodeJson::allocateNode())
+, m_errorHandler(mode)
+, m_isRoot(true)
+{
+	m_node->setAsObj();
+}
+
+//--------------------------------------------------------------------
+
+inline JsonImpl::JsonImpl(JsonObjBuffer* jsonBufferPtr, ErrorHandlerMode mode)
+: m_jsonBufferPtr(jsonBufferPtr)
 , m_node(NodeJson::allocateNode())
 , m_errorHandler(mode)
 , m_isRoot(true)
@@ -443,14 +511,14 @@ inline JsonImpl::JsonImpl(const char* data, ErrorHandlerMode mode)
 //--------------------------------------------------------------------
 
 inline JsonImpl::JsonImpl(ErrorHandlerMode mode)
-: JsonImpl(" ", mode)
+: JsonImpl(" ", 1, mode)
 {
 }
 
 //--------------------------------------------------------------------
 
 inline JsonImpl::JsonImpl(size_t bufferSize, ErrorHandlerMode mode)
-: m_jsonBufferPtr(new JsonObjBuffer(" ", bufferSize))
+: m_jsonBufferPtr(new JsonObjBuffer(bufferSize))
 , m_node(NodeJson::allocateNode())
 , m_errorHandler(mode)
 , m_isRoot(true)
@@ -463,13 +531,15 @@ inline JsonImpl::JsonImpl(size_t bufferSize, ErrorHandlerMode mode)
 inline JsonImpl::~JsonImpl()
 {
 	if(m_isRoot){
-		if(m_node){
+		// the nodes of an arena go with it, in ~JsonObjBuffer
+		if(m_node && !(m_jsonBufferPtr && m_jsonBufferPtr->arena())){
 			NodeJson::freeNode(m_node);
-			m_node=nullptr;
 		}
+		m_node=nullptr;
 		if(m_jsonBufferPtr){
 			delete m_jsonBufferPtr;
 		}
+		Allocator::Small_Object_Allocator::trimAboveWatermark();
 	}
 }
 
@@ -502,6 +572,8 @@ inline std::string JsonImpl::toString(bool pretty) const
 
 inline bool JsonImpl::hasKey(const char* key) const
 {
+	// an unindexed object frees its duplicates when it gets indexed
+	auto scope=arenaScope();
 	if(!failWhen(m_node->isArray(), ErrorCode::error13)){
 		NodeJson::AVL_Tree tree(*m_jsonBufferPtr);
 		return tree.find(m_node, key)!=nullptr;
@@ -553,6 +625,7 @@ std::optional<json_null> JsonImpl::getValue<json_null>() const [[maybe_unused]]
 
 inline void JsonImpl::operator=(easyjson::JsonValue&& val)
 {
+	auto scope=arenaScope();
 	m_node->clear();
 	easyjson::setData(val, m_node, *m_jsonBufferPtr);
 }
@@ -564,6 +637,7 @@ inline void JsonImpl::operator=(easyjson::JsonValue&& val)
  * */
 inline void JsonImpl::operator=(std::initializer_list<easyjson::JsonValue>&& list)
 {
+	auto scope=arenaScope();
 	initArray(std::move(list), [this](const JsonValue& data, NodeJson* node){
 		easyjson::setData(data, node, *m_jsonBufferPtr);
 	});
@@ -575,7 +649,8 @@ inline void JsonImpl::operator=(std::initializer_list<easyjson::JsonValue>&& lis
  *  obj[a]={{b, 1}, {c, 2}, {d, 3}} --> a:[{b:1}, {c:2}, {d:3}] 
  * */
 inline void JsonImpl::operator=(std::initializer_list<easyjson::JsonPair>&& list)
-{	
+{
+	auto scope=arenaScope();
 	NodeJson::AVL_Tree tree(*m_jsonBufferPtr);
 	initArray(std::move(list), [&tree, this](const JsonPair& data, NodeJson* node){
 		node->setAsObj();
@@ -621,6 +696,7 @@ void JsonImpl::initArray(std::initializer_list<T>&& list, FUNC cbk)
 // insert an element (number or string) into array: 
 inline void JsonImpl::pushBack(easyjson::JsonValue&& data)
 {
+	auto scope=arenaScope();
 	if(!failWhen(m_node->isObj() || m_node->m_offset>0, ErrorCode::error15)){
 		if(!m_node->isArray()){
 			m_node->setAsArray();
@@ -661,6 +737,7 @@ inline void JsonImpl::pushBack(easyjson::JsonBulkList&& data)
 template<typename T, typename FUNC>
 inline void JsonImpl::pushBackData(T&& data, FUNC cbk)
 {
+	auto scope=arenaScope();
 	if(failWhen(m_node->isObj(), ErrorCode::error14)){
 		return;
 	}
@@ -694,6 +771,7 @@ inline void JsonImpl::pushBack(json_obj)
 //add {key:val} to obj
 inline void JsonImpl::append(easyjson::JsonPair&& data)
 {
+	auto scope=arenaScope();
 	if(!failWhen(m_node->isArray(), ErrorCode::error16)){
 		if(!failWhen(hasKey(data.m_key),ErrorCode::error17)){
 			m_node->setAsObj();
@@ -715,7 +793,7 @@ inline NodeJson* JsonImpl::nodeAt(uint idx) const
 		return nullptr;
 	}
 
-	NodeJson::VectWrapper* vect=reinterpret_cast<NodeJson::VectWrapper*>(m_node->m_child);
+	NodeJson::VectWrapper* vect=m_node->vect();
 
 	return vect->get(idx);
 }
@@ -724,6 +802,7 @@ inline NodeJson* JsonImpl::nodeAt(uint idx) const
 
 inline void JsonImpl::removeKey(const char* key)
 {
+	auto scope=arenaScope();
 	if(failWhen(!m_node->isObj(), ErrorCode::error13)){
 		return;
 	}
@@ -736,11 +815,12 @@ inline void JsonImpl::removeKey(const char* key)
 
 inline void JsonImpl::removeFromArray(size_t idx, bool shift)
 {
+	auto scope=arenaScope();
 	if(failWhen(!m_node->isArray(), ErrorCode::error13)){
 		return;
 	}
 
-	NodeJson::VectWrapper* vect=reinterpret_cast<NodeJson::VectWrapper*>(m_node->m_child);
+	NodeJson::VectWrapper* vect=m_node->vect();
 
 	vect->remove(idx, shift);
 }
@@ -753,11 +833,26 @@ inline size_t JsonImpl::size() const
 		return size_t(-1);
 	}
 
-	NodeJson::VectWrapper* vect=reinterpret_cast<NodeJson::VectWrapper*>(m_node->m_child);
+	NodeJson::VectWrapper* vect=m_node->vect();
 
 	return vect->size();
 }
 
+//--------------------------------------------------------------------
+
+inline JsonDocumentStats JsonImpl::memoryStats() const
+{
+	JsonDocumentStats stats;
+	if(m_node){
+		m_node->countNodes(stats.m_nodes, stats.m_vectors);
+	}
+	if(m_jsonBufferPtr){
+		stats.m_bufferBytes=m_jsonBufferPtr->bufferCapacity();
+		stats.m_wastedBytes=stats.m_bufferBytes-m_jsonBufferPtr->bufferSize();
+	}
+	return stats;
+}
+
 //====================================================================
 
 }// simplejson namespace
@@ -800,146 +895,53 @@ std::string JsonParser::utf8Encode(const char* cstr)
 
 //--------------------------------------------------------------------
 
-namespace
-{
-	enum NumFormat : unsigned char
-	{
-		none=0,
-		neg=1,
-		pst=1<<1,
-		dots=1<<2,
-		eCount=1<<3,
-		bad=neg | pst,
-		bad2=eCount | neg | pst,
-	};
-}
-
-inline int JsonParser::parseValueData(char* cstr, ErrorReporting& errorHandler, NodeJson* node)
-{
-	if(cstr[0]!='-' && (int(cstr[0])<48 || int(cstr[0])>57)){
-		size_t k=0;
-		bool a=true;
-		if(cstr[0]=='n'){
-			k=4;
-			a=cstr[1]=='u' && cstr[2]=='l' && cstr[3]=='l';
-			node->setDataMode(JSON_TYPES::_NULL); 
-		}
-		else if(cstr[0]=='t'){
-			k=4;
-			a=cstr[1]=='r' && cstr[2]=='u' && cstr[3]=='e';
-			node->setDataMode(JSON_TYPES::_BOOL);
-		}
-		else if(cstr[0]=='f'){
-			k=5;
-			a=cstr[1]=='a' && cstr[2]=='l' && cstr[3]=='s' && cstr[4]=='e';
-			node->setDataMode(JSON_TYPES::_BOOL);
-		}
-		else{ //k==0
-			errorHandler.setError(ErrorCode::error1);
-			return -1;
-		}
-
-		if(cstr[k]==0 || !a){
-			errorHandler.setError(ErrorCode::error1);
-			return -1;
-		}
-
-		if(int(cstr[k])<33){// && std::isspace(static_cast<unsigned char>(cstr[k]))){
-			cstr[k]=0;
+/*
+ * The number in [first, last), as scanScalar found it. It stays text
+ * only if it does not convert as a whole, i.e. out of double range.
+ * */
+inline void JsonParser::decodeNumber(const char* first, const char* last, JSON_TYPES type, NodeJson* node)
+{
+	if(type==JSON_TYPES::_NUM){
+		int64_t integer;
+		std::from_chars_result result=std::from_chars(first, last, integer);
+		if(result.ec==std::errc() && result.ptr==last){
+			node->setNumber(integer);
+			return;
 		}
-		return k-1;
-	}
-
-	// Leading zeroes
-	// notice that cstr[1] is valid since it could be '\0'
-	if(cstr[0]==48 && (cstr[1]==48 || cstr[1]=='e' || cstr[1]=='E')){
-		errorHandler.setError(ErrorCode::error5);
-		return -1;
 	}
 
-	node->setDataMode(JSON_TYPES::_NUM);
-
-	unsigned char format=0;
-
-	size_t i=0;
-
-	if(cstr[i]=='-'){
-		format=NumFormat::neg;
-		i++;
+	// correctly rounded, with no locale involved
+	double real;
+	std::from_chars_result result=std::from_chars(first, last, real);
+	if(result.ec==std::errc() && result.ptr==last){
+		node->setNumber(real);
 	}
+}
 
-	i--; // !!
-	while(true){
-		while(cstr[++i]>47 && cstr[i]<58);// ;-)
-
-		if(cstr[i]==',' || cstr[i]=='}' || cstr[i]==']'){
-			break;
-		}
-
-		if(int(cstr[i])<33){// As we are parsing a numeric value, we don't need to check for specific white characters
-			cstr[i]=0;
-			break;
-		}
-
-		if(cstr[i]=='-'){
-			if(format & NumFormat::bad){
-				errorHandler.setError(ErrorCode::error5);
-				return -1;
-			}
-			format=format|NumFormat::neg;
-			//i++;
-			continue;
-		}
-
-		if(cstr[i]=='+'){
-			if(0==(format & NumFormat::eCount) || format & NumFormat::bad){
-				errorHandler.setError(ErrorCode::error5);
-				return -1;
-			}
-			format=format|NumFormat::pst;
-			//i++;
-			continue;
-		}
-
-		if(cstr[i]=='e' || cstr[i]=='E'){
-			if(format & NumFormat::eCount){
-				errorHandler.setError(ErrorCode::error5);
-				return -1;
-			}
-			format=format&~NumFormat::neg;
-			format=format | NumFormat::eCount | NumFormat::dots;// dots are not allowed after e/E
-			//i++;
-			continue;
-		}
+//--------------------------------------------------------------------
 
-		if(cstr[i]=='.'){
-			if(format & NumFormat::dots){
-				errorHandler.setError(ErrorCode::error5);
-				return -1;
-			}
-			format=format|NumFormat::dots;
-			node->setDataMode(JSON_TYPES::_DOUBLE);
-			//i++;
-			continue;
-		}
+inline int JsonParser::parseValueData(char* cstr, ErrorReporting& errorHandler, NodeJson* node, bool decodeNumbers)
+{
+	JSON_TYPES type;
+	ErrorCode errorCode;
 
-		errorHandler.setError(ErrorCode::error5);
+	int a=scanScalar(cstr, type, errorCode);
+	if(a<0){
+		errorHandler.setError(errorCode);
 		return -1;
 	}
 
-	if(format & NumFormat::eCount){
-		if(cstr[i-1]=='e' || cstr[i-1]=='E'){
-			errorHandler.setError(ErrorCode::error5);
-			return -1;
-		}
+	node->setDataMode(type);
+
+	if(int(cstr[a+1])<33){
+		cstr[a+1]=0;
 	}
 
-	if(cstr[i-1]=='.'){
-		errorHandler.setError(ErrorCode::error6);
-		return -1;
+	if(decodeNumbers && (type==JSON_TYPES::_NUM || type==JSON_TYPES::_DOUBLE)){
+		decodeNumber(cstr, cstr+a+1, type, node);
 	}
 
-	return i-1;
+	return a;
 }
 
 //--------------------------------------------------------------------
@@ -954,12 +956,17 @@ namespace
 	struct NodeGard
 	{
 		~NodeGard()
+		{
+			release();
+		}
+
+		void release()
 		{
 			if(m_nodePtr){
 				if(m_nodePtr->isKey()){
 					NodeJson::freeNode(m_nodePtr);
-					m_nodePtr=nullptr;
 				}
+				m_nodePtr=nullptr;
 			}
 		}
 
@@ -999,162 +1006,877 @@ namespace
 			{
 				return m_conQ>0;
 			}
+
+			// the vector keeps its capacity
+			void clear()
+			{
+				m_conQ=0;
+				m_conA=m_conVect.size();
+			}
+
+			int depth() const
+			{
+				return m_conQ;
+			}
 	
 		private:
 			std::vector<NodeJson*> m_conVect;
 			int m_conQ{0};
 			int m_conA{0};
 	};
-}
-
-void JsonParser::parserLoop(JsonObjBuffer* jsonObjBufferPtr, NodeJson* node, ErrorReporting& errorHandler)
-{	
-	char* buffer=jsonObjBufferPtr->m_buffer.data();
 
-	NodeJson* rootNode=node;
-	
-	SyntaxRules rule;
-	rule.setRuleInitial();
+	/*
+	 * Paths of a projection (JsonObj::parseProjected), one node per
+	 * segment. A node where a path ends is whole: everything under it
+	 * is kept. What is under a '*' is merged into its siblings, so the
+	 * node found for a key or an index holds every path it is on.
+	 * */
+	class PathTrie
+	{
+		public:
+			struct Node
+			{
+				std::vector<std::pair<std::string, size_t>> m_children;
+				size_t m_any{0}; // child for '*', 0 if none
+				bool m_whole{false};
+			};
 
-	NodeGard nodeGard;
+			explicit PathTrie(std::span<const std::string_view> paths)
+			{
+				m_nodes.emplace_back();
+				for(std::string_view path : paths){
+					add(path);
+				}
 
-	NodeJson::AVL_Tree tree(*jsonObjBufferPtr);
+				// the merged nodes are appended, so they are visited too
+				for(size_t idx=0; idx<m_nodes.size(); idx++){
+					if(m_nodes[idx].m_any>0){
+						for(size_t i=0; i<m_nodes[idx].m_children.size(); i++){
+							merge(m_nodes[idx].m_any, m_nodes[idx].m_children[i].second);
+						}
+					}
+				}
+			}
 
-	NodeJson* activeContainer=nullptr;
+			~PathTrie()=default;
 
-	NodeDeck nodeDeck;
+			const Node* root() const
+			{
+				return m_nodes[0].m_whole? nullptr : &m_nodes[0];
+			}
 
-	bool parsingString=false;
-	int k=0;
-	//*
-	int i=0;
-	while(buffer[i]){ // ok...
-		if(buffer[i]<33){ // we discart any white character outside a key or value
-			i++;
-			continue;
-		}// */
-	/*
-	int i=-1;
-	START_LOOP:
-	{
-		while(buffer[++i]<33 && buffer[i]>0);
-		if(buffer[i]==0){
-			goto FINISH_JSON;
-		}
-		
-		/*
-		if(int(buffer[i])<33){
-			bool a=true;
-			while(a){
-				switch(buffer[i]){
-					case ' ':
-					case '\n':
-					case '\r':
-					case '\t':
-						i++;
-						break;
-					default:
-						a=false;
+			/*
+			 * The value under name in a scope of node: nullptr if it is
+			 * left out, with keepAll set if it is kept as a whole.
+			 * */
+			const Node* child(const Node* node, std::string_view name, bool& keepAll) const
+			{
+				size_t idx=node->m_any;
+				for(auto& child : node->m_children){
+					if(child.first==name){
+						idx=child.second;
 						break;
+					}
 				}
+
+				keepAll=idx>0 && m_nodes[idx].m_whole;
+				return idx>0? &m_nodes[idx] : nullptr;
 			}
-			if(buffer[i]==0){
-				goto FINISH_JSON;
-			}
-		}// */
 
-		switch(buffer[i]){
-			case '"':
-				{
-					if(!node->isKey() && !node->isObj()){
-						if(!rule.syntaxRuleValue()){
-							errorHandler.setError(ErrorCode::error1);
-							goto FINISH_JSON;
-						}
+		private:
+			std::vector<Node> m_nodes;
+
+			// made if there is none yet, '*' for the any child
+			size_t childAt(size_t idx, std::string_view segment)
+			{
+				if(segment=="*"){
+					if(m_nodes[idx].m_any==0){
+						m_nodes[idx].m_any=m_nodes.size();
+						m_nodes.emplace_back();
 					}
-					else{
-						if(!rule.syntaxRuleKey()){
-							errorHandler.setError(ErrorCode::error9);
-							goto FINISH_JSON;
-						}
+					return m_nodes[idx].m_any;
+				}
 
-						node=node->addKeyNode();
-						nodeGard.m_nodePtr=node;
+				for(auto& child : m_nodes[idx].m_children){
+					if(child.first==segment){
+						return child.second;
 					}
+				}
 
-					i++;
-					node->m_offset=i;				
+				m_nodes[idx].m_children.emplace_back(segment, m_nodes.size());
+				m_nodes.emplace_back();
 
-					parsingString=true;
+				return m_nodes.size()-1;
+			}
 
-					while(buffer[i]!=0){
-						if(buffer[i]=='"'){
-							break;
-						}
+			void add(std::string_view path)
+			{
+				size_t idx=0;
+				bool more=!path.empty(); // "" is the whole document
+				while(more && !m_nodes[idx].m_whole){
+					size_t pos=path.find('/');
+					std::string_view segment=path.substr(0, pos);
+					more=pos!=std::string_view::npos; // "a/" ends with the key ""
+					if(more){
+						path.remove_prefix(pos+1);
+					}
 
-						if(buffer[i]=='\\'){
-							if(buffer[i+1]=='\\'){
-								i++;
-							}
-							else if(buffer[i+1]=='u' || buffer[i+1]=='U'){
-								if(isHexValid(buffer+i+1)){
-									i+=5; // u(H1)(H2)(H3)(H4) 5 characters for a valid hex
-								}
-								else{
-									errorHandler.setError(ErrorCode::error1);
-									goto FINISH_JSON;
-								}
-							}
-							else if(buffer[i+1]=='"'){
-								i++;
-								k++;
-							}
-							else if(buffer[i+1]=='/' || buffer[i+1]=='b' 
-									|| buffer[i+1]=='f' || buffer[i+1]=='n' || buffer[i+1]=='r' 
-									|| buffer[i+1]=='t')
-							{
-								i++;
-							}
-							else{
-								errorHandler.setError(ErrorCode::error1);
-								goto FINISH_JSON;
-							}	
-						}
-						else {
-							if(buffer[i]<14 && buffer[i]>0){//control characters//13='\n', 12 || buffer[i]=='\t' || buffer[i]=='\b' || buffer[i]=='\r' || buffer[i]=='\f'){
-								errorHandler.setError(ErrorCode::error1);
-								goto FINISH_JSON;
-							}
-						}
-						
-						if(k>0){
-							buffer[i-k]=buffer[i];
-						}
+					idx=childAt(idx, segment);
+				}
 
-						i++;
-					}
+				m_nodes[idx].m_whole=true;
+			}
 
-					if(parsingString){
-						parsingString=false;
-						buffer[i]='\0';
-						buffer[i-k]='\0';					
+			// the paths under src are added under dst
+			void merge(size_t src, size_t dst)
+			{
+				if(m_nodes[dst].m_whole){
+					return;
+				}
 
-						node->setDataMode(JSON_TYPES::_STR);
+				if(m_nodes[src].m_whole){
+					m_nodes[dst].m_whole=true;
+					return;
+				}
 
-						if(node->isKey()){
-							nodeGard.m_nodePtr=nullptr;
-							if(!tree.insertAt(activeContainer, node)){
-								NodeJson::freeNode(node);
-								errorHandler.setError(ErrorCode::error17);
-								goto FINISH_JSON;
-							}
-							rule.setRuleColon();
+				for(size_t i=0; i<m_nodes[src].m_children.size(); i++){
+					// m_nodes may grow, nothing is held by reference
+					std::string segment=m_nodes[src].m_children[i].first;
+					size_t next=m_nodes[src].m_children[i].second;
+					merge(next, childAt(dst, segment));
+				}
+
+				if(m_nodes[src].m_any>0){
+					merge(m_nodes[src].m_any, childAt(dst, "*"));
+				}
+			}
+	};
+
+	// an open scope of a projection, m_node is null once all of it is kept
+	struct ProjectionFrame
+	{
+		const PathTrie::Node* m_node;
+		size_t m_items{0};
+	};
+
+	/*
+	 * Whether the value under name, in the scope of frame, is kept: its
+	 * node in the trie, null if all of it is kept, skip set if it is
+	 * left out.
+	 * */
+	inline const PathTrie::Node* selectValue(const PathTrie& paths, const ProjectionFrame& frame, std::string_view name, bool& skip)
+	{
+		skip=false;
+		if(!frame.m_node){
+			return nullptr;
+		}
+
+		bool keepAll;
+		const PathTrie::Node* target=paths.child(frame.m_node, name, keepAll);
+		skip=!target;
+
+		return keepAll? nullptr : target;
+	}
+
+	// as selectValue, for the next item of an array
+	inline const PathTrie::Node* selectItem(const PathTrie& paths, ProjectionFrame& frame, bool& skip)
+	{
+		char digits[24];
+		std::to_chars_result result=std::to_chars(digits, digits+sizeof(digits), frame.m_items++);
+
+		return selectValue(paths, frame, std::string_view(digits, result.ptr-digits), skip);
+	}
+
+	/*
+	 * Consumes the entries of an object or array left out of a
+	 * projection, up to its closing bracket: only the brackets and the
+	 * quotes are matched. False if the input ends first.
+	 * */
+	bool skipScope(StructuralIndex& index, const char* buffer)
+	{
+		size_t depth=1;
+		uint32_t entry;
+		while((entry=index.next())!=StructuralIndex::c_END){
+			switch(buffer[entry & ~StructuralIndex::c_DIRTY]){
+				case '"':
+					if(index.next()==StructuralIndex::c_END){
+						return false;
+					}
+					break;
+				case '{':
+				case '[':
+					depth++;
+					break;
+				case '}':
+				case ']':
+					if(--depth==0){
+						return true;
+					}
+					break;
+			}
+		}
+
+		return false;
+	}
+}
+
+namespace easyjson
+{
+/*
+ * Everything parseEntries needs to carry on where it stopped, so a
+ * document can be parsed in several goes (JsonStreamParser).
+ * */
+class ParserContext
+{
+	public:
+		ParserContext(JsonObjBuffer& jsonObjBuffer, const char* buffer, size_t length, NodeJson* node, bool streaming=false)
+		: m_jsonObjBuffer(jsonObjBuffer)
+		, m_rootNode(node)
+		, m_node(node)
+		, m_tree(jsonObjBuffer)
+		, m_index(buffer, length, streaming)
+		{
+			m_rule.setRuleInitial();
+		}
+
+		~ParserContext()=default;
+
+		/*
+		 * Ready for another document in the same JsonObjBuffer, node is
+		 * its root. What was allocated (the container stack and the
+		 * index) is kept. m_nodeGard has to be released before the
+		 * previous document goes.
+		 * */
+		void reset(const char* buffer, size_t length, NodeJson* node)
+		{
+			m_rootNode=node;
+			m_node=node;
+			m_activeContainer=nullptr;
+			m_rule.setRuleInitial();
+			m_nodeDeck.clear();
+			m_index.reset(buffer, length);
+			m_trailingScalar=false;
+			m_end=ErrorReporting::c_NO_POSITION;
+			m_lazy=false;
+			m_decodeNumbers=false;
+			m_trustedInput=false;
+			m_paths=nullptr;
+			m_frames.clear();
+			m_target=nullptr;
+			m_skip=false;
+		}
+
+	private:
+		JsonObjBuffer& m_jsonObjBuffer;
+		NodeJson* m_rootNode;
+		NodeJson* m_node;
+		NodeJson* m_activeContainer{nullptr};
+		JsonParser::SyntaxRules m_rule;
+		NodeGard m_nodeGard;
+		NodeDeck m_nodeDeck;
+		NodeJson::AVL_Tree m_tree;
+		StructuralIndex m_index;
+		bool m_trailingScalar{false};
+		size_t m_end{ErrorReporting::c_NO_POSITION}; // see inputEnd
+		size_t m_origin{0}; // JsonStreamParser, where the input starts in the buffer
+		bool m_lazy{false}; // nested scopes are skipped and left lazy
+		bool m_decodeNumbers{false}; // ParseOptions::m_decodeNumbers
+		bool m_trustedInput{false}; // ParseOptions::m_trustedInput
+
+		// projection: the values that are not on these paths are skipped
+		const PathTrie* m_paths{nullptr};
+		std::vector<ProjectionFrame> m_frames;
+		const PathTrie::Node* m_target{nullptr}; // trie node of the next value
+		bool m_skip{false}; // the next value is left out
+
+		ParserContext(const ParserContext&)=delete;
+		ParserContext& operator=(const ParserContext&)=delete;
+
+	friend class JsonParser;
+};
+}
+
+//--------------------------------------------------------------------
+
+size_t JsonParser::inputLength(JsonObjBuffer* jsonObjBufferPtr, bool& trailingScalar, size_t& end)
+{
+	const char* buffer=jsonObjBufferPtr->m_data;
+	size_t length=jsonObjBufferPtr->bufferSize();
+	end=inputEnd(buffer, length);
+
+	trailingScalar=false;
+	if(jsonObjBufferPtr->isInSitu()){
+		/*
+		 * There is no '\0' after the caller's buffer to stop a scalar.
+		 * A valid document ends with '}' or ']', so a scalar at the end
+		 * (i.e. '[1, 2') is left out of the index and reported when
+		 * parsing finishes, that way nothing is read past the buffer.
+		 * */
+		length=end;
+		while(length>0 && StructuralIndex::isScalarByte(buffer[length-1])){
+			trailingScalar=true;
+			length--;
+		}
+	}
+
+	return length;
+}
+
+//--------------------------------------------------------------------
+
+/*
+ * The end of the input, whitespace aside: where an incomplete document
+ * is reported. It is read before parsing writes into the buffer.
+ * */
+size_t JsonParser::inputEnd(const char* buffer, size_t length)
+{
+	while(length>0 && int(buffer[length-1])<33){
+		length--;
+	}
+	return length;
+}
+
+//--------------------------------------------------------------------
+/*
+ * Positions past StructuralIndex::c_MAX_LENGTH cannot be indexed, such
+ * an input is rejected before anything of it is read.
+ * */
+
+inline bool JsonParser::tooLarge(size_t length, ErrorReporting& errorHandler)
+{
+	if(length>StructuralIndex::c_MAX_LENGTH){
+		errorHandler.setError(ErrorCode::error28);
+		return true;
+	}
+	return false;
+}
+
+//--------------------------------------------------------------------
+
+void JsonParser::parserLoop(JsonObjBuffer* jsonObjBufferPtr, NodeJson* node, ErrorReporting& errorHandler, const ParseOptions& options)
+{	
+	if(tooLarge(jsonObjBufferPtr->bufferSize(), errorHandler)){
+		return;
+	}
+
+	char* buffer=jsonObjBufferPtr->m_data;
+
+	bool trailingScalar;
+	size_t end;
+	size_t length=inputLength(jsonObjBufferPtr, trailingScalar, end);
+
+	// the length is known, so the input may hold anything after the document
+	ParserContext context(*jsonObjBufferPtr, buffer, length, node);
+	context.m_trailingScalar=trailingScalar;
+	context.m_end=end;
+	context.m_decodeNumbers=options.m_decodeNumbers;
+	context.m_trustedInput=options.m_trustedInput;
+	if(options.m_strictUTF8){
+		context.m_index.validateUTF8();
+	}
+	if(options.m_internKeys){
+		jsonObjBufferPtr->internKeys();
+	}
+
+	parseEntries(context, errorHandler);
+	finishParsing(context, errorHandler);
+}
+
+//--------------------------------------------------------------------
+
+/*
+ * Parses the items of the top level array found in [first, last).
+ * Unless the range is the first one, node is a blank array that takes
+ * the items and parsing starts right after the ',' at first. Unless it
+ * is the final one, the range ends before the ',' at last, where a
+ * complete item is expected.
+ * */
+ErrorCode JsonParser::parseItems(JsonObjBuffer& jsonObjBuffer, NodeJson* node, size_t first, size_t last, bool final, bool trailingScalar, size_t end, size_t& position)
+{
+	ErrorReporting errorHandler(ErrorHandlerMode::Quiet);
+
+	ParserContext context(jsonObjBuffer, jsonObjBuffer.m_data, last, node);
+
+	if(first>0){
+		node->setAsArray();
+		context.m_nodeDeck.addContainer(node);
+		context.m_activeContainer=node;
+		context.m_node=node->addArrayItem();
+		context.m_rule.setRuleValue();
+		context.m_index.skipTo(first+1);
+	}
+
+	parseEntries(context, errorHandler);
+
+	if(final){
+		context.m_trailingScalar=trailingScalar;
+		context.m_end=end;
+		finishParsing(context, errorHandler);
+	}
+	else if(errorHandler.isValid() && (!context.m_rule.syntaxRuleReady() || context.m_nodeDeck.depth()!=1)){
+		// as the ',' at last would be reported (i.e. '[1, , 2]')
+		errorHandler.setError(ErrorCode::error1, last);
+	}
+
+	position=errorHandler.m_position;
+	return errorHandler.m_errorCode;
+}
+
+//--------------------------------------------------------------------
+
+#ifndef JSON_PARALLEL_MIN_BYTES
+#define JSON_PARALLEL_MIN_BYTES (1<<20) // per thread
+#endif
+
+void JsonParser::parallelLoop(JsonObjBuffer* jsonObjBufferPtr, NodeJson* node, ErrorReporting& errorHandler, unsigned threadCount)
+{
+	if(tooLarge(jsonObjBufferPtr->bufferSize(), errorHandler)){
+		return;
+	}
+
+	char* buffer=jsonObjBufferPtr->m_data;
+
+	bool trailingScalar;
+	size_t end;
+	const size_t length=inputLength(jsonObjBufferPtr, trailingScalar, end);
+
+	size_t first=0;
+	while(first<length && int(buffer[first])<33){
+		first++;
+	}
+
+	threadCount=std::min<size_t>(threadCount, length/JSON_PARALLEL_MIN_BYTES);
+	if(threadCount<2 || first==length || buffer[first]!='['){
+		parserLoop(jsonObjBufferPtr, node, errorHandler);
+		return;
+	}
+
+	/*
+	 * The input is cut in equal ranges, one per thread, and each
+	 * thread summarizes its range (quotes and nesting). From that,
+	 * every thread knows the state at the start of its range and looks
+	 * for the first ',' between two items of the top level array: the
+	 * items between that one and the next thread's are parsed in place
+	 * into an array of its own, with pools of its own. The items are
+	 * moved to the document in order at the end.
+	 * */
+	struct Chunk
+	{
+		size_t m_first;
+		size_t m_last;
+		NodeJson* m_items{nullptr};
+		ErrorCode m_errorCode{ErrorCode::error0};
+		size_t m_position{ErrorReporting::c_NO_POSITION};
+	};
+
+	std::vector<size_t> bounds(threadCount+1);
+	for(unsigned t=0; t<=threadCount; t++){
+		bounds[t]=length*t/threadCount;
+	}
+
+	std::vector<RangeSummary> summaries(threadCount);
+	std::vector<Chunk> chunks(threadCount);
+	std::vector<std::optional<Allocator::Small_Object_Allocator::ThreadPools>> threadPools(threadCount);
+	std::vector<std::vector<Allocator::MemPool>> loans=Allocator::Small_Object_Allocator::lend(threadCount-1);
+
+	std::latch summarized(threadCount);
+	std::latch located(threadCount);
+
+	std::exception_ptr error;
+	std::mutex errorMutex;
+
+	auto work=[&](unsigned t){
+		try{
+			if(t>0){
+				threadPools[t].emplace(std::move(loans[t-1]));
+			}
+
+			summaries[t]=summarizeRange(buffer, bounds[t], bounds[t+1]);
+			summarized.arrive_and_wait();
+
+			bool inString=false;
+			int64_t depth=0;
+			for(unsigned i=0; i<t; i++){
+				depth+=summaries[i].m_depth[inString];
+				inString=inString^summaries[i].m_oddQuotes;
+			}
+
+			chunks[t].m_first=t==0? 0 : findSeparator(buffer, bounds[t], length, inString, depth);
+			located.arrive_and_wait();
+
+			Chunk& chunk=chunks[t];
+			chunk.m_last=length;
+			for(unsigned i=t+1; i<threadCount; i++){
+				if(chunks[i].m_first<length){
+					chunk.m_last=chunks[i].m_first;
+					break;
+				}
+			}
+
+			if(chunk.m_first>=chunk.m_last){ // taken by the previous range
+				return;
+			}
+
+			NodeJson* items=node;
+			if(t>0){
+				items=NodeJson::allocateNode();
+				chunk.m_items=items;
+			}
+
+			chunk.m_errorCode=parseItems(*jsonObjBufferPtr, items, chunk.m_first, chunk.m_last, chunk.m_last==length, trailingScalar, end, chunk.m_position);
+		}
+		catch(...){
+			std::lock_guard<std::mutex> lock(errorMutex);
+			if(!error){
+				error=std::current_exception();
+			}
+			chunks[t].m_errorCode=ErrorCode::error20;
+		}
+	};
+
+	std::vector<std::thread> workers;
+	workers.reserve(threadCount-1);
+
+	for(unsigned t=1; t<threadCount; t++){
+		workers.emplace_back(work, t);
+	}
+
+	work(0);
+
+	for(auto& worker : workers){
+		worker.join();
+	}
+
+	// the nodes built by the workers now belong to this thread
+	for(auto& pools : threadPools){
+		if(pools){
+			pools->handOver();
+		}
+	}
+
+	ErrorCode errorCode=ErrorCode::error0;
+	size_t position=ErrorReporting::c_NO_POSITION;
+	for(auto& chunk : chunks){
+		if(errorCode==ErrorCode::error0){
+			errorCode=chunk.m_errorCode;
+			position=chunk.m_position;
+		}
+	}
+
+	for(auto& chunk : chunks){
+		if(chunk.m_items){
+			if(errorCode==ErrorCode::error0){
+				buffer[chunk.m_first]=0; // the ',' that no thread went through
+				node->vect()->splice(*chunk.m_items->vect());
+			}
+			NodeJson::freeNode(chunk.m_items);
+		}
+	}
+
+	if(error){
+		std::rethrow_exception(error);
+	}
+
+	if(errorCode!=ErrorCode::error0){
+		errorHandler.setError(errorCode, position);
+	}
+}
+
+//--------------------------------------------------------------------
+
+void JsonParser::lazyLoop(JsonObjBuffer* jsonObjBufferPtr, NodeJson* node, ErrorReporting& errorHandler)
+{
+	const char* buffer=jsonObjBufferPtr->m_data;
+	size_t length=jsonObjBufferPtr->bufferSize();
+	if(tooLarge(length, errorHandler)){
+		return;
+	}
+
+	/*
+	 * The whole document is checked, duplicate keys included, so
+	 * parseLazy fails exactly where parse would and parsing a scope
+	 * later on cannot fail. Nothing is built but the map of scopes.
+	 * */
+	jsonObjBufferPtr->m_scopeMap=new ScopeMap;
+
+	JsonSaxHandler noEvents;
+	ScopeStack scopes;
+	KeySet keys(buffer);
+	size_t position;
+
+	ErrorCode errorCode=parseEvents(buffer, length, noEvents, scopes, &keys, position, jsonObjBufferPtr->m_scopeMap);
+	if(errorCode!=ErrorCode::error0){
+		errorHandler.setError(errorCode, position);
+		return;
+	}
+
+	// the root scope only
+	ParserContext context(*jsonObjBufferPtr, buffer, length, node);
+	context.m_lazy=true;
+
+	parseEntries(context, errorHandler);
+	finishParsing(context, errorHandler);
+}
+
+//--------------------------------------------------------------------
+
+void JsonParser::projectionLoop(JsonObjBuffer* jsonObjBufferPtr, NodeJson* node, ErrorReporting& errorHandler, std::span<const std::string_view> paths)
+{
+	if(tooLarge(jsonObjBufferPtr->bufferSize(), errorHandler)){
+		return;
+	}
+
+	PathTrie pathTrie(paths);
+
+	bool trailingScalar;
+	size_t end;
+	size_t length=inputLength(jsonObjBufferPtr, trailingScalar, end);
+
+	ParserContext context(*jsonObjBufferPtr, jsonObjBufferPtr->m_data, length, node);
+	context.m_trailingScalar=trailingScalar;
+	context.m_end=end;
+	context.m_paths=&pathTrie;
+
+	parseEntries(context, errorHandler);
+	finishParsing(context, errorHandler);
+}
+
+//--------------------------------------------------------------------
+
+void JsonParser::parseScope(JsonObjBuffer* jsonObjBufferPtr, NodeJson* node, ErrorReporting& errorHandler)
+{
+	const size_t first=node->getOffset();
+	const size_t last=jsonObjBufferPtr->scopeEnd(first);
+
+	node->setNone();
+	node->setOffset(0);
+
+	ParserContext context(*jsonObjBufferPtr, jsonObjBufferPtr->m_data, last+1, node);
+	context.m_lazy=true;
+	context.m_index.skipTo(first);
+
+	/*
+	 * parseLazy has checked the whole document, a failure here means
+	 * the check and the parser disagree: it is recorded in the buffer
+	 * so that every JsonObj of the document reports it, then passed on.
+	 * */
+	ErrorReporting scopeErrorHandler(ErrorHandlerMode::Quiet);
+	parseEntries(context, scopeErrorHandler);
+	finishParsing(context, scopeErrorHandler);
+
+	if(!scopeErrorHandler.isValid()){
+		if(jsonObjBufferPtr->m_scopeError==ErrorCode::error0){
+			jsonObjBufferPtr->m_scopeError=scopeErrorHandler.m_errorCode;
+		}
+		errorHandler.setError(scopeErrorHandler.m_errorCode);
+	}
+}
+
+//--------------------------------------------------------------------
+
+inline void JsonImpl::materialize()
+{
+	auto scope=arenaScope();
+	JsonParser::parseScope(m_jsonBufferPtr, m_node, m_errorHandler);
+}
+
+//--------------------------------------------------------------------
+
+void JsonParser::parseEntries(ParserContext& context, ErrorReporting& errorHandler)
+{
+	char* buffer=context.m_jsonObjBuffer.m_data;
+
+	// kept in registers while looping, stored back below
+	NodeJson* node=context.m_node;
+	NodeJson* activeContainer=context.m_activeContainer;
+	SyntaxRules rule=context.m_rule;
+
+	NodeGard& nodeGard=context.m_nodeGard;
+	NodeJson::AVL_Tree& tree=context.m_tree;
+	NodeDeck& nodeDeck=context.m_nodeDeck;
+	StructuralIndex& index=context.m_index;
+	const bool lazy=context.m_lazy;
+	const bool decodeNumbers=context.m_decodeNumbers;
+	const bool trustedInput=context.m_trustedInput;
+	KeyTable* keys=context.m_jsonObjBuffer.keys();
+
+	const PathTrie* paths=context.m_paths;
+	std::vector<ProjectionFrame>& frames=context.m_frames;
+	const PathTrie::Node* target=context.m_target;
+	bool skip=context.m_skip;
+
+	int k=0;
+	size_t i=0;
+	uint32_t entry;
+	while((entry=index.next())!=StructuralIndex::c_END){
+		i=entry;
+
+		switch(buffer[i]){
+			case '"':
+				{
+					if(!node){ // the root scope is already closed
+						errorHandler.setError(ErrorCode::error26);
+						goto FINISH_JSON;
+					}
+
+					if(skip){ // a value left out of the projection
+						if(index.next()==StructuralIndex::c_END){
+							context.m_trailingScalar=false; // if any, it is part of the string
+							goto FINISH_JSON;
 						}
-						else{
-							rule.setRuleReady();
+						skip=false;
+						rule.setRuleReady();
+						break;
+					}
+
+					// the node of a key is made once the key is known
+					const bool isKey=node->isKey() || node->isObj();
+					if(!isKey){
+						if(!rule.syntaxRuleValue()){
+							errorHandler.setError(ErrorCode::error1);
+							goto FINISH_JSON;
+						}
+					}
+					else{
+						if(!rule.syntaxRuleKey()){
+							errorHandler.setError(ErrorCode::error9);
+							goto FINISH_JSON;
+						}
+					}
+
+					i++;
+					const size_t offset=i;
+
+					uint32_t closing=index.next();
+					if(closing==StructuralIndex::c_END){
+						// unterminated string, reported as an open scope below
+						context.m_trailingScalar=false; // if any, it is part of the string
+						goto FINISH_JSON;
+					}
+
+					// whether the decoded string has to be escaped back when printing
+					bool escaped=false;
+
+					if(closing & StructuralIndex::c_DIRTY){
+						closing&=~StructuralIndex::c_DIRTY;
+
+						/*
+						 * Every escape sequence is decoded in place, the text never
+						 * gets longer: the plain runs are skipped and shifted left by
+						 * k (the bytes saved so far) in one go, only the sequences
+						 * themselves are looked at.
+						 * */
+						while(true){
+							size_t next=findEscapeOrControl(buffer+i, buffer+closing)-buffer;
+							if(k>0){
+								std::memmove(buffer+i-k, buffer+i, next-i);
+							}
+							i=next;
+
+							if(i>=closing){
+								break;
+							}
+
+							if(buffer[i]!='\\'){//control characters
+								errorHandler.setError(ErrorCode::error1);
+								goto FINISH_JSON;
+							}
+
+							char decoded;
+							switch(buffer[i+1]){
+								case '"':
+								case '\\':
+									decoded=buffer[i+1];
+									escaped=true;
+									break;
+								case '/':
+									decoded='/';
+									break;
+								case 'b':
+									decoded='\b';
+									escaped=true;
+									break;
+								case 'f':
+									decoded='\f';
+									escaped=true;
+									break;
+								case 'n':
+									decoded='\n';
+									escaped=true;
+									break;
+								case 'r':
+									decoded='\r';
+									escaped=true;
+									break;
+								case 't':
+									decoded='\t';
+									escaped=true;
+									break;
+								case 'u':
+									{
+										int written;
+										uint32_t codePoint;
+										int length=decodeUnicodeEscape(buffer+i, buffer+i-k, written, codePoint);
+										if(length==0){
+											errorHandler.setError(ErrorCode::error1);
+											goto FINISH_JSON;
+										}
+										escaped=escaped || codePoint<32 || codePoint=='"' || codePoint=='\\' || (codePoint>=0xD800 && codePoint<0xE000);
+										k+=length-written;
+										i+=length;
+										continue;
+									}
+								default:
+									errorHandler.setError(ErrorCode::error1);
+									goto FINISH_JSON;
+							}
+
+							buffer[i-k]=decoded;
+							k++;
+							i+=2;
+						}
+					}
+					else{
+						i=closing;
+					}
+
+					buffer[i]='\0';
+					buffer[i-k]='\0';					
+
+					if(isKey){
+						if(paths){
+							target=selectValue(*paths, frames.back(), std::string_view(buffer+offset, i-k-offset), skip);
+							if(skip){
+								rule.setRuleColon();
+								k=0;
+								break;
+							}
 						}
-						k=0;
+
+						node=node->addKeyNode();
+						nodeGard.m_nodePtr=node;
+					}
+
+					node->m_offset=(isKey && keys)? keys->intern(buffer, offset, i-k-offset) : offset;
+					node->setDataMode(JSON_TYPES::_STR);
+					node->setEscaped(escaped);
+
+					if(isKey){
+						nodeGard.m_nodePtr=nullptr;
+						if(trustedInput){
+							activeContainer->pushKey(node);
+						}
+						else if(!tree.insertAt(activeContainer, node)){
+							NodeJson::freeNode(node);
+							errorHandler.setError(ErrorCode::error17, offset-1); // at the quote
+							goto FINISH_JSON;
+						}
+						rule.setRuleColon();
+					}
+					else{
+						rule.setRuleReady();
 					}
+					k=0;
 					break;
 				}
 			case '{':
@@ -1164,11 +1886,32 @@ void JsonParser::parserLoop(JsonObjBuffer* jsonObjBufferPtr, NodeJson* node, Err
 						goto FINISH_JSON;
 					}
 
+					if(skip){
+						if(!skipScope(index, buffer)){
+							goto FINISH_JSON;
+						}
+						skip=false;
+						rule.setRuleReady();
+						break;
+					}
+
+					if(lazy && nodeDeck.hasNodes()){
+						node->setLazy(i, true);
+						index.skipTo(context.m_jsonObjBuffer.scopeEnd(i)+1);
+						rule.setRuleReady();
+						break;
+					}
+
 					node->setAsObj();
 					
 					nodeDeck.addContainer(node);
 					
 					activeContainer=node;
+
+					if(paths){
+						frames.push_back({frames.empty()? paths->root() : target});
+					}
+
 					rule.setRuleObj();
 					break;
 				}
@@ -1186,6 +1929,10 @@ void JsonParser::parserLoop(JsonObjBuffer* jsonObjBufferPtr, NodeJson* node, Err
 					
 					buffer[i]=0;
 
+					if(paths){
+						frames.pop_back();
+					}
+
 					node=nodeDeck.closeScope();
 					activeContainer=node;
 
@@ -1199,11 +1946,37 @@ void JsonParser::parserLoop(JsonObjBuffer* jsonObjBufferPtr, NodeJson* node, Err
 						goto FINISH_JSON;
 					}
 
+					if(skip){
+						if(!skipScope(index, buffer)){
+							goto FINISH_JSON;
+						}
+						skip=false;
+						rule.setRuleReady();
+						break;
+					}
+
+					if(lazy && nodeDeck.hasNodes()){
+						node->setLazy(i, false);
+						index.skipTo(context.m_jsonObjBuffer.scopeEnd(i)+1);
+						rule.setRuleReady();
+						break;
+					}
+
 					node->setAsArray();
 
 					nodeDeck.addContainer(node);
 					activeContainer=node;
-					node=node->addArrayItem();
+
+					if(!paths){
+						node=node->addArrayItem();
+					}
+					else{
+						frames.push_back({frames.empty()? paths->root() : target});
+						target=selectItem(*paths, frames.back(), skip);
+
+						// no item is made for a value left out
+						node=skip? activeContainer : node->addArrayItem();
+					}
 
 					rule.setRuleArr();
 					break;
@@ -1222,6 +1995,11 @@ void JsonParser::parserLoop(JsonObjBuffer* jsonObjBufferPtr, NodeJson* node, Err
 					
 					buffer[i]=0;
 
+					if(paths){
+						frames.pop_back();
+						skip=false; // i.e. '[]'
+					}
+
 					removeEmptyIndex(activeContainer);
 					
 					node=nodeDeck.closeScope();
@@ -1240,7 +2018,13 @@ void JsonParser::parserLoop(JsonObjBuffer* jsonObjBufferPtr, NodeJson* node, Err
 					buffer[i]=0;
 
 					if(activeContainer->isArray()){
-						node=activeContainer->addArrayItem();
+						if(!paths){
+							node=activeContainer->addArrayItem();
+						}
+						else{
+							target=selectItem(*paths, frames.back(), skip);
+							node=skip? activeContainer : activeContainer->addArrayItem();
+						}
 						rule.setRuleValue();
 					}
 					else{
@@ -1256,7 +2040,9 @@ void JsonParser::parserLoop(JsonObjBuffer* jsonObjBufferPtr, NodeJson* node, Err
 						goto FINISH_JSON;
 					}
 					buffer[i]=0;
-					node=node->addBlankChild();
+					if(!skip){
+						node=node->addBlankChild();
+					}
 					rule.setRuleValue();
 					break;
 				}
@@ -1267,104 +2053,467 @@ void JsonParser::parserLoop(JsonObjBuffer* jsonObjBufferPtr, NodeJson* node, Err
 						goto FINISH_JSON;
 					}
 
-					node->setOffset(i);
+					if(skip){ // not even checked
+						skip=false;
+						rule.setRuleReady();
+						break;
+					}
+
+					node->setOffset(i);
+
+					int a=parseValueData(&buffer[i], errorHandler, node, decodeNumbers);
+
+					if(a<0){
+						goto FINISH_JSON;
+					}
+
+					// only the first byte of a scalar is indexed, e.g. 'truex'
+					if(StructuralIndex::isScalarByte(buffer[i+a+1])){
+						errorHandler.setError(ErrorCode::error1);
+						goto FINISH_JSON;
+					}
+					i+=a;
+
+					rule.setRuleReady();
+					break;
+				}
+		}
+	}
+
+	FINISH_JSON:
+
+	if(!errorHandler.isValid() && errorHandler.m_position==ErrorReporting::c_NO_POSITION){
+		errorHandler.m_position=i;
+	}
+
+	context.m_node=node;
+	context.m_activeContainer=activeContainer;
+	context.m_rule=rule;
+	context.m_target=target;
+	context.m_skip=skip;
+}
+
+//--------------------------------------------------------------------
+
+void JsonParser::finishParsing(ParserContext& context, ErrorReporting& errorHandler)
+{
+	if(errorHandler.isValid()){
+		size_t scalarStart=0;
+		const ErrorCode scalarError=context.m_trailingScalar? trailingScalarError(context, scalarStart) : ErrorCode::error0;
+
+		if(context.m_index.utf8Error()!=StructuralIndex::c_VALID){// indexing stopped there
+			errorHandler.setError(ErrorCode::error27, context.m_index.utf8Error());
+		}
+		else if(scalarError!=ErrorCode::error0){
+			errorHandler.setError(scalarError, scalarStart);
+		}
+		else if(context.m_nodeDeck.hasNodes()){// We should end with the same node as we began
+			errorHandler.setError(ErrorCode::error3, context.m_end);
+		}
+		else if(context.m_trailingScalar){
+			errorHandler.setError(ErrorCode::error1, scalarStart);
+		}
+		else if(!context.m_rootNode->child() && context.m_rule.syntaxRuleInitial()){
+			errorHandler.setError(ErrorCode::error21, context.m_end);
+		}
+	}
+}
+
+//--------------------------------------------------------------------
+
+/*
+ * The error parse gives for the scalar that inputLength leaves out of
+ * the index of an in situ document, error0 if it has none; first is
+ * where the scalar starts. As in parseEvents, it is scanned as if a
+ * '\0' followed it.
+ * */
+ErrorCode JsonParser::trailingScalarError(ParserContext& context, size_t& first)
+{
+	const JsonObjBuffer& jsonObjBuffer=context.m_jsonObjBuffer;
+	const char* buffer=jsonObjBuffer.m_data;
+	const size_t last=context.m_end;
+	first=last;
+	while(first>0 && StructuralIndex::isScalarByte(buffer[first-1])){
+		first--;
+	}
+
+	if(!context.m_rule.syntaxRuleValue()){
+		return ErrorCode::error1;
+	}
+
+	// whitespace after the scalar stops it, otherwise it is copied
+	const size_t scalarLength=last-first;
+	char local[64];
+	std::string copy;
+	const char* scalar=buffer+first;
+	if(last==jsonObjBuffer.bufferSize()){
+		if(scalarLength<sizeof(local)){
+			std::memcpy(local, scalar, scalarLength);
+			local[scalarLength]='\0';
+			scalar=local;
+		}
+		else{
+			copy.assign(scalar, scalarLength);
+			scalar=copy.c_str();
+		}
+	}
+
+	JSON_TYPES type;
+	ErrorCode errorCode=ErrorCode::error0;
+	int a=scanScalar(scalar, type, errorCode);
+	if(a>=0 && size_t(a+1)<scalarLength){ // e.g. 'truex'
+		errorCode=ErrorCode::error1;
+	}
+	return errorCode;
+}
+
+//--------------------------------------------------------------------
+
+size_t JsonParser::fileLength(JsonImpl* fileImplPtr)
+{
+	return fileImplPtr->isValid()? fileImplPtr->m_jsonBufferPtr->bufferSize() : 0;
+}
+
+//--------------------------------------------------------------------
+
+/*
+ * Start of the first line at or after position.
+ * */
+size_t JsonParser::lineStart(JsonImpl* fileImplPtr, size_t position)
+{
+	const size_t length=fileLength(fileImplPtr);
+	if(position==0 || position>=length){
+		return position<length? position : length;
+	}
+
+	const char* buffer=fileImplPtr->m_jsonBufferPtr->m_data;
+	const char* end=static_cast<const char*>(std::memchr(buffer+position-1, '\n', length-position+1));
+
+	return end? end-buffer+1 : length;
+}
+
+//--------------------------------------------------------------------
+
+size_t JsonParser::countLines(JsonImpl* fileImplPtr, size_t first, size_t last)
+{
+	const char* buffer=fileImplPtr->m_jsonBufferPtr->m_data;
+	return std::count(buffer+first, buffer+last, '\n');
+}
+
+//--------------------------------------------------------------------
+
+bool JsonParser::nextLine(JsonImpl* fileImplPtr, size_t& position, size_t last, const char*& line, size_t& length)
+{
+	if(position>=last){
+		return false;
+	}
+
+	const char* buffer=fileImplPtr->m_jsonBufferPtr->m_data;
+
+	line=buffer+position;
+	const char* end=static_cast<const char*>(std::memchr(line, '\n', last-position));
+	if(!end){
+		end=buffer+last;
+	}
+
+	position=end-buffer+1;
+	length=end-line;
+
+	if(length>0 && line[length-1]=='\r'){
+		length--;
+	}
+
+	return true;
+}
+
+//--------------------------------------------------------------------
+
+void JsonParser::parseLine(JsonImpl* JsonImplPtr, const char* line, size_t length)
+{
+	// the nodes of the previous line go back to the pools and are reused straight away
+	NodeJson::freeNode(JsonImplPtr->m_node);
+	JsonImplPtr->m_node=NodeJson::allocateNode();
+	JsonImplPtr->m_node->setAsObj();
+
+	JsonImplPtr->m_errorHandler.reset();
+
+	/*
+	 * The line is copied into the buffer of the previous one: it stays
+	 * in cache and, unlike parsing in place, no page of the mapping has
+	 * to be duplicated.
+	 * */
+	JsonImplPtr->m_jsonBufferPtr->assign(line, length);
+
+	parserLoop(JsonImplPtr->m_jsonBufferPtr, JsonImplPtr->m_node, JsonImplPtr->m_errorHandler);
+}
+
+//--------------------------------------------------------------------
+
+JsonImpl* JsonParser::parseDocument(std::string_view document, ErrorHandlerMode mode)
+{
+	JsonImpl* JsonImplPtr=new JsonImpl(document.data(), document.size(), mode);
+
+	// whatever the mode, the error stays with the document
+	ErrorReporting errorHandler(ErrorHandlerMode::Quiet);
+	parserLoop(JsonImplPtr->m_jsonBufferPtr, JsonImplPtr->m_node, errorHandler);
+	JsonImplPtr->m_errorHandler.m_errorCode=errorHandler.m_errorCode;
+
+	return JsonImplPtr;
+}
+
+//--------------------------------------------------------------------
+
+std::vector<JsonImpl*> JsonParser::parseMany(std::span<const std::string_view> documents, unsigned threadCount, ErrorHandlerMode mode)
+{
+	std::vector<JsonImpl*> impls(documents.size(), nullptr);
+
+	threadCount=std::min<size_t>(threadCount, documents.size());
+	if(threadCount<2){
+		try{
+			for(size_t i=0; i<documents.size(); i++){
+				impls[i]=parseDocument(documents[i], mode);
+			}
+		}
+		catch(...){
+			for(JsonImpl* impl : impls){
+				delete impl;
+			}
+			throw;
+		}
+
+		return impls;
+	}
+
+	WorkQueue queue(documents.size(), threadCount);
+
+	std::vector<std::optional<Allocator::Small_Object_Allocator::ThreadPools>> threadPools(threadCount);
+	std::vector<std::vector<Allocator::MemPool>> loans=Allocator::Small_Object_Allocator::lend(threadCount);
+
+	std::exception_ptr error;
+	std::mutex errorMutex;
+	std::atomic<bool> stop{false};
+
+	std::vector<std::thread> workers;
+	workers.reserve(threadCount);
+
+	for(unsigned t=0; t<threadCount; t++){
+		workers.emplace_back([&, t](){
+			try{
+				// the documents outlive the thread, its pools are handed over
+				threadPools[t].emplace(std::move(loans[t]));
+
+				size_t idx;
+				while(!stop.load(std::memory_order_relaxed) && queue.next(t, idx)){
+					impls[idx]=parseDocument(documents[idx], mode);
+				}
+			}
+			catch(...){
+				std::lock_guard<std::mutex> lock(errorMutex);
+				if(!error){
+					error=std::current_exception();
+				}
+				stop=true;
+			}
+		});
+	}
+
+	for(auto& worker : workers){
+		worker.join();
+	}
+
+	for(auto& pools : threadPools){
+		if(pools){
+			pools->handOver();
+		}
+	}
+
+	if(error){
+		for(JsonImpl* impl : impls){
+			delete impl;
+		}
+		std::rethrow_exception(error);
+	}
+
+	return impls;
+}
+
+//--------------------------------------------------------------------
+
+ParserContext* JsonParser::openStream(JsonImpl* JsonImplPtr)
+{
+	JsonObjBuffer* jsonObjBufferPtr=JsonImplPtr->m_jsonBufferPtr;
+	ParserContext* context=new ParserContext(*jsonObjBufferPtr, jsonObjBufferPtr->m_data, jsonObjBufferPtr->bufferSize(), JsonImplPtr->m_node, true);
+	context->m_origin=jsonObjBufferPtr->bufferSize();
+	context->m_end=context->m_origin; // moved on by parseChunk
+	return context;
+}
+
+//--------------------------------------------------------------------
+
+void JsonParser::parseChunk(JsonImpl* JsonImplPtr, ParserContext* context, const char* chunk, size_t length)
+{
+	JsonObjBuffer* jsonObjBufferPtr=JsonImplPtr->m_jsonBufferPtr;
+	if(tooLarge(jsonObjBufferPtr->bufferSize()+length, JsonImplPtr->m_errorHandler)){
+		return;
+	}
+
+	if(size_t end=inputEnd(chunk, length)){
+		context->m_end=jsonObjBufferPtr->bufferSize()+end;
+	}
+	jsonObjBufferPtr->appendChunk(chunk, length);
+	context->m_index.extend(jsonObjBufferPtr->m_data, jsonObjBufferPtr->bufferSize());
+
+	parseEntries(*context, JsonImplPtr->m_errorHandler);
+	streamPosition(*context, JsonImplPtr->m_errorHandler);
+}
+
+//--------------------------------------------------------------------
+
+void JsonParser::closeStream(JsonImpl* JsonImplPtr, ParserContext* context)
+{
+	context->m_index.setFinal();
+
+	parseEntries(*context, JsonImplPtr->m_errorHandler);
+	finishParsing(*context, JsonImplPtr->m_errorHandler);
+	streamPosition(*context, JsonImplPtr->m_errorHandler);
+}
+
+//--------------------------------------------------------------------
+
+// the position of an error in the input fed rather than in the buffer (see openStream)
+void JsonParser::streamPosition(const ParserContext& context, ErrorReporting& errorHandler)
+{
+	if(!errorHandler.isValid() && errorHandler.m_position!=ErrorReporting::c_NO_POSITION){
+		errorHandler.m_position-=context.m_origin;
+	}
+}
+
+//--------------------------------------------------------------------
 
-					int a=parseValueData(&buffer[i], errorHandler, node);
+ParserContext* JsonParser::openContext(JsonImpl* JsonImplPtr)
+{
+	JsonObjBuffer* jsonObjBufferPtr=JsonImplPtr->m_jsonBufferPtr;
+	return new ParserContext(*jsonObjBufferPtr, jsonObjBufferPtr->m_data, jsonObjBufferPtr->bufferSize(), JsonImplPtr->m_node);
+}
 
-					if(a<0){
-						goto FINISH_JSON;
-					}
-					i+=a;
-					if(buffer[i+1]=='\0'){
-						i++;
-					}
-					rule.setRuleReady();
-					break;
-				}
-		}
-		i++;
-		//goto START_LOOP;
+//--------------------------------------------------------------------
+
+void JsonParser::reparse(JsonImpl* JsonImplPtr, ParserContext* context, const char* str, size_t length, const ParseOptions& options)
+{
+	JsonObjBuffer* jsonObjBufferPtr=JsonImplPtr->m_jsonBufferPtr;
+
+	Allocator::Small_Object_Allocator::Arena* arena=jsonObjBufferPtr->arena();
+	if(options.m_arena && !arena){
+		// the first document, the root comes from the process pools
+		context->m_nodeGard.release();
+		NodeJson::freeNode(JsonImplPtr->m_node);
+		JsonImplPtr->m_node=nullptr;
+		arena=jsonObjBufferPtr->useArena();
 	}
+	Allocator::Small_Object_Allocator::Arena::Scope scope(arena);
 
-	FINISH_JSON:
+	// a key left behind by an error is not in the tree
+	context->m_nodeGard.release();
 
-	if(errorHandler.isValid()){
-		if(nodeDeck.hasNodes()){// We should end with the same node as we began
-			errorHandler.setError(ErrorCode::error3);
-		}
-		
-		if(!rootNode->m_child && rule.syntaxRuleInitial()){
-			errorHandler.setError(ErrorCode::error21);
-		}
+	// as in parseLine, the nodes of the previous document are taken again straight away
+	if(JsonImplPtr->m_node){
+		NodeJson::freeNode(JsonImplPtr->m_node);
+	}
+	JsonImplPtr->m_node=NodeJson::allocateNode();
+	JsonImplPtr->m_node->setAsObj();
+
+	JsonImplPtr->m_errorHandler.reset();
+
+	if(tooLarge(length, JsonImplPtr->m_errorHandler)){
+		return;
+	}
+
+	jsonObjBufferPtr->assign(str, length);
+
+	bool trailingScalar;
+	size_t end;
+	context->reset(jsonObjBufferPtr->m_data, inputLength(jsonObjBufferPtr, trailingScalar, end), JsonImplPtr->m_node);
+	context->m_trailingScalar=trailingScalar;
+	context->m_end=end;
+	context->m_decodeNumbers=options.m_decodeNumbers;
+	context->m_trustedInput=options.m_trustedInput;
+	if(options.m_strictUTF8){
+		context->m_index.validateUTF8();
+	}
+	if(options.m_internKeys){
+		jsonObjBufferPtr->internKeys();
+	}
+
+	parseEntries(*context, JsonImplPtr->m_errorHandler);
+	finishParsing(*context, JsonImplPtr->m_errorHandler);
+}
+
+//--------------------------------------------------------------------
+
+void JsonParser::closeContext(JsonImpl* JsonImplPtr, ParserContext* context)
+{
+	// the key the context may hold comes from the arena of the document
+	Allocator::Small_Object_Allocator::Arena::Scope scope(JsonImplPtr->m_jsonBufferPtr->arena());
+	delete context;
+}
+
+//--------------------------------------------------------------------
+
+JsonImpl* JsonParser::openJsonFile(const char* jsonFileName, ErrorHandlerMode mode, unsigned threadCount)
+{
+	// a file too large to be indexed is neither mapped nor read
+	JsonImpl* JsonImplPtr=loadJsonFile(jsonFileName, mode, true, StructuralIndex::c_MAX_LENGTH);
+
+	if(JsonImplPtr->isValid()){
+		parallelLoop(JsonImplPtr->m_jsonBufferPtr, JsonImplPtr->m_node, JsonImplPtr->m_errorHandler, threadCount);
 	}
+
+	return JsonImplPtr;
 }
 
 //--------------------------------------------------------------------
 
-JsonImpl* JsonParser::openJsonFile(const char* jsonFileName, ErrorHandlerMode mode)
+JsonImpl* JsonParser::loadJsonFile(const char* jsonFileName, ErrorHandlerMode mode, bool writable, size_t maxLength)
 {
 	JsonImpl* JsonImplPtr=nullptr;
 
 	size_t fileLength=0;
-	//profiler.start();
-	
-	//=================
-	#if 0
-	FILE* file = fopen(jsonFileName, "rb");
-	if (!file) {
-		fprintf(stderr, "Failed to open file\n");
-		//return 1;
-	}
-	fseek(file, 0, SEEK_END);
-	size_t length = ftell(file);
-	fseek(file, 0, SEEK_SET);
-
-			JsonImplPtr=new JsonImpl(length+1, mode);
-			
-			char* buffer=JsonImplPtr->m_jsonBufferPtr->m_buffer.data();
-			buffer[fileLength]=0;
-	
-	//char* buffer = new char[length];
-	if (length == fread(buffer, 1, length, file)) {
-		fclose(file);
-		parserLoop(JsonImplPtr->m_jsonBufferPtr, JsonImplPtr->m_node, JsonImplPtr->m_errorHandler);
-		return JsonImplPtr;
-	}
-	fclose(file);
-	#endif
-	//=================
-	
-	#if 1
+
+	if(JsonObjBuffer* jsonBufferPtr=JsonObjBuffer::mapFile(jsonFileName, fileLength, writable, maxLength)){
+		return new JsonImpl(jsonBufferPtr, mode);
+	}
+
+	// files that cannot be mapped (pipes, /proc...) are read in
 	std::ifstream jsonFile(jsonFileName);
-	if(jsonFile.is_open()){
+	if(jsonFile.is_open() && fileLength<=maxLength){
 		jsonFile.seekg(0, std::ios_base::end);
 		std::ifstream::pos_type endPos = jsonFile.tellg();
 		jsonFile.seekg(0, std::ios_base::beg);
 
 		fileLength=endPos-jsonFile.tellg();
 	
-      if(fileLength>1){
-			JsonImplPtr=new JsonImpl(fileLength+1, mode);
+      if(fileLength>1 && fileLength<=maxLength){
+			JsonImplPtr=new JsonImpl(fileLength, mode);
 			
-			char* buffer=JsonImplPtr->m_jsonBufferPtr->m_buffer.data();
+			char* buffer=JsonImplPtr->m_jsonBufferPtr->m_data;
 
 			jsonFile.read(buffer, fileLength);
-			buffer[fileLength]=0;
 			
 			if(jsonFile){
 				jsonFile.close();
-				parserLoop(JsonImplPtr->m_jsonBufferPtr, JsonImplPtr->m_node, JsonImplPtr->m_errorHandler);
-				//profiler.stop();
 				return JsonImplPtr;
 			}
+			delete JsonImplPtr;
 		}
 		jsonFile.close();
 	}
-	#endif
 
 	JsonImplPtr=new JsonImpl(mode);
 	ErrorCode error=ErrorCode::error22;
-	if(fileLength<2){
+	if(fileLength>maxLength){
+		error=ErrorCode::error28;
+	}
+	else if(fileLength<2){
 		error=ErrorCode::error25;
 	}
 	JsonImplPtr->m_errorHandler.setError(error);
@@ -1379,6 +2528,7 @@ JsonImpl* JsonParser::openJsonFile(const char* jsonFileName, ErrorHandlerMode mo
  * */
 NodeJson* JsonImpl::find(const char* key) const
 {
+	auto scope=arenaScope();
 	if(failWhen(m_node->isArray(), ErrorCode::error13)){
 		return nullptr;
 	}
@@ -1390,7 +2540,7 @@ NodeJson* JsonImpl::find(const char* key) const
 	NodeJson* node=NodeJson::AVL_Tree::find(*m_jsonBufferPtr, m_node, key);
 	
 	if(node){
-		return node->m_child;
+		return node->child();
 	}
 	
 	NodeJson::AVL_Tree tree(*m_jsonBufferPtr);
@@ -1410,6 +2560,7 @@ NodeJson* JsonImpl::find(const char* key) const
 //m_node->m_child->m_child(obj)
 void JsonImpl::operator=(easyjson::JsonBulkList&& data)
 {
+	auto scope=arenaScope();
 	m_node->clear();
 	m_node->setAsObj();
 
@@ -1421,7 +2572,7 @@ void JsonImpl::operator=(easyjson::JsonBulkList&& data)
 	for(auto& nodeData : data.m_list){
 		isIn=false;
 		
-		if(m_node->m_child){
+		if(m_node->child()){
 			isIn=tree.find(m_node, nodeData.m_key);
 		}
 		
@@ -1489,6 +2640,58 @@ JsonObj JsonObj::parse(const char* str, ErrorHandlerMode mode)
 	return JsonParser::parse(str, mode);
 }
 
+JsonObj JsonObj::parse(const char* str, size_t length, ErrorHandlerMode mode)
+{
+	return JsonParser::parse(str, length, mode);
+}
+
+JsonObj JsonObj::parse(const char* str, size_t length, const ParseOptions& options, ErrorHandlerMode mode)
+{
+	return JsonParser::parse(str, length, options, mode);
+}
+
+JsonObj JsonObj::parse(const char* str, size_t length, unsigned threadCount, ErrorHandlerMode mode)
+{
+	return JsonParser::parse(str, length, threadCount, mode);
+}
+
+JsonObj JsonObj::parseInSitu(char* buffer, size_t length, ErrorHandlerMode mode)
+{
+	return JsonParser::parseInSitu(buffer, length, mode);
+}
+
+JsonObj JsonObj::parseLazy(const char* str, size_t length, ErrorHandlerMode mode)
+{
+	return JsonParser::parseLazy(str, length, mode);
+}
+
+JsonObj JsonObj::parseProjected(const char* str, size_t length, std::span<const std::string_view> paths, ErrorHandlerMode mode)
+{
+	return JsonParser::parseProjected(str, length, paths, mode);
+}
+
+JsonDocuments JsonObj::parseMany(std::span<const std::string_view> documents, unsigned threadCount, ErrorHandlerMode mode)
+{
+	return JsonDocuments(JsonParser::parseMany(documents, threadCount, mode));
+}
+
+JsonValidation JsonObj::validate(std::string_view str, bool checkDuplicateKeys)
+{
+	JsonSaxHandler noEvents;
+	ScopeStack scopes;
+	JsonValidation result;
+
+	if(checkDuplicateKeys){
+		KeySet keys(str.data());
+		result.m_errorCode=parseEvents(str.data(), str.size(), noEvents, scopes, &keys, result.m_position);
+	}
+	else{
+		result.m_errorCode=parseEvents(str.data(), str.size(), noEvents, scopes, nullptr, result.m_position);
+	}
+
+	return result;
+}
+
 JsonObj JsonObj::initObj(ErrorHandlerMode mode)
 {
 	return JsonParser::initObj(mode);
@@ -1500,6 +2703,11 @@ JsonObj JsonObj::parseJsonFile(const char* jsonFileName, ErrorHandlerMode mode)
 	return {JsonParser::openJsonFile(jsonFileName, mode)};
 }
 
+JsonObj JsonObj::parseJsonFile(const char* jsonFileName, unsigned threadCount, ErrorHandlerMode mode)
+{
+	return {JsonParser::openJsonFile(jsonFileName, mode, threadCount)};
+}
+
 bool JsonObj::hasKey(const char* key) const
 {
 	return m_impl->hasKey(key);	
@@ -1598,6 +2806,11 @@ const char* JsonObj::getRawData() const
 	return m_impl->getRawData();
 }
 
+JSON_TYPES JsonObj::getDecoded(int64_t& integer, double& real) const
+{
+	return m_impl->getDecoded(integer, real);
+}
+
 void JsonObj::removeKey(const char* key)
 {
 	m_impl->removeKey(key);
@@ -1653,11 +2866,21 @@ std::string JsonObj::getErrorMsg() const
 	return m_impl->getErrorMsg();
 }
 
+size_t JsonObj::getErrorPosition() const
+{
+	return m_impl->getErrorPosition();
+}
+
 size_t JsonObj::size() const
 {
 	return m_impl->size();
 }
 
+JsonDocumentStats JsonObj::memoryStats() const
+{
+	return m_impl->memoryStats();
+}
+
 //--------------------------------------------------------------------
 
 std::string JsonObj::utf8Encode(const char* cstr)
@@ -1689,3 +2912,297 @@ std::string JsonObj::utf8Encode(const char* cstr)
 }
 
 //====================================================================
+
+JsonStreamParser::JsonStreamParser(ErrorHandlerMode mode)
+: m_mode(mode)
+{
+}
+
+//--------------------------------------------------------------------
+
+JsonStreamParser::~JsonStreamParser()
+{
+	reset();
+}
+
+//--------------------------------------------------------------------
+
+void JsonStreamParser::reset()
+{
+	// the context may hold a key that is not in the tree yet
+	delete m_context;
+	m_context=nullptr;
+
+	delete m_impl;
+	m_impl=nullptr;
+}
+
+//--------------------------------------------------------------------
+
+bool JsonStreamParser::feed(const char* chunk, size_t length)
+{
+	if(!m_impl){
+		m_impl=JsonParser::initObj(m_mode);
+		m_context=JsonParser::openStream(m_impl);
+	}
+
+	if(m_impl->isValid()){
+		JsonParser::parseChunk(m_impl, m_context, chunk, length);
+	}
+
+	return m_impl->isValid();
+}
+
+//--------------------------------------------------------------------
+
+JsonObj JsonStreamParser::finish()
+{
+	if(!m_impl){
+		feed("", 0);
+	}
+
+	if(m_impl->isValid()){
+		JsonParser::closeStream(m_impl, m_context);
+	}
+
+	delete m_context;
+	m_context=nullptr;
+
+	JsonImpl* impl=m_impl;
+	m_impl=nullptr;
+
+	return {impl};
+}
+
+//--------------------------------------------------------------------
+
+bool JsonStreamParser::isValid() const
+{
+	return !m_impl || m_impl->isValid();
+}
+
+//--------------------------------------------------------------------
+
+std::string JsonStreamParser::getErrorMsg() const
+{
+	if(!m_impl){
+		return "";
+	}
+	return m_impl->getErrorMsg();
+}
+
+//====================================================================
+
+JsonReusableParser::JsonReusableParser(const ParseOptions& options, ErrorHandlerMode mode)
+: m_document(JsonParser::initObj(mode))
+, m_context(JsonParser::openContext(m_document.m_impl))
+, m_options(options)
+{
+}
+
+//--------------------------------------------------------------------
+
+JsonReusableParser::~JsonReusableParser()
+{
+	// the context may hold a key that is not in the tree yet
+	JsonParser::closeContext(m_document.m_impl, m_context);
+}
+
+//--------------------------------------------------------------------
+
+JsonObj& JsonReusableParser::parse(const char* str, size_t length)
+{
+	JsonParser::reparse(m_document.m_impl, m_context, str, length, m_options);
+	return m_document;
+}
+
+//====================================================================
+
+JsonLinesReader::JsonLinesReader(const char* jsonFileName, ErrorHandlerMode mode)
+: m_file(JsonParser::loadJsonFile(jsonFileName, mode, false))
+, m_document(JsonParser::initObj(mode))
+, m_mode(mode)
+{
+	m_length=JsonParser::fileLength(m_file);
+}
+
+//--------------------------------------------------------------------
+
+JsonLinesReader::~JsonLinesReader()
+{
+	delete m_file;
+}
+
+//--------------------------------------------------------------------
+
+bool JsonLinesReader::isValid() const
+{
+	return m_file->isValid();
+}
+
+//--------------------------------------------------------------------
+
+std::string JsonLinesReader::getErrorMsg() const
+{
+	return m_file->getErrorMsg();
+}
+
+//--------------------------------------------------------------------
+
+bool JsonLinesReader::next()
+{
+	const char* line;
+	size_t length;
+	while(JsonParser::nextLine(m_file, m_position, m_length, line, length)){
+		m_lineNumber++;
+		if(length>0){
+			JsonParser::parseLine(m_document.m_impl, line, length);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//--------------------------------------------------------------------
+
+size_t JsonLinesReader::parseRange(size_t first, size_t last, size_t lineNumber, const std::function<void(JsonObj&, size_t)>& cbk, const std::atomic<bool>& stop) const
+{
+	JsonObj document(JsonParser::initObj(m_mode));
+
+	const char* line;
+	size_t length;
+	while(!stop.load(std::memory_order_relaxed) && JsonParser::nextLine(m_file, first, last, line, length)){
+		lineNumber++;
+		if(length>0){
+			JsonParser::parseLine(document.m_impl, line, length);
+			cbk(document, lineNumber);
+		}
+	}
+
+	return lineNumber;
+}
+
+//--------------------------------------------------------------------
+
+void JsonLinesReader::forEach(const std::function<void(JsonObj&, size_t)>& cbk, unsigned threadCount)
+{
+	const size_t first=m_position;
+	const size_t lineNumber=m_lineNumber;
+
+	m_position=m_length;
+
+	std::atomic<bool> stop{false};
+
+	if(threadCount<2){
+		m_lineNumber=parseRange(first, m_length, lineNumber, cbk, stop);
+		return;
+	}
+
+	// the remaining bytes are split evenly, each range starts on a line
+	std::vector<size_t> bounds(threadCount+1);
+	for(unsigned i=0; i<threadCount; i++){
+		bounds[i]=JsonParser::lineStart(m_file, first+(m_length-first)*i/threadCount);
+	}
+	bounds[threadCount]=m_length;
+
+	std::vector<size_t> lineCounts(threadCount);
+	size_t lastLineNumber=lineNumber;
+	std::latch counted(threadCount);
+
+	std::exception_ptr error;
+	std::mutex errorMutex;
+
+	std::vector<std::thread> workers;
+	workers.reserve(threadCount);
+
+	for(unsigned t=0; t<threadCount; t++){
+		workers.emplace_back([&, t](){
+			// the documents of this thread never leave it
+			Allocator::Small_Object_Allocator::ThreadPools threadPools;
+
+			lineCounts[t]=JsonParser::countLines(m_file, bounds[t], bounds[t+1]);
+			counted.arrive_and_wait();
+
+			size_t rangeLineNumber=lineNumber;
+			for(unsigned i=0; i<t; i++){
+				rangeLineNumber+=lineCounts[i];
+			}
+
+			try{
+				rangeLineNumber=parseRange(bounds[t], bounds[t+1], rangeLineNumber, cbk, stop);
+				if(t==threadCount-1){
+					lastLineNumber=rangeLineNumber;
+				}
+			}
+			catch(...){
+				std::lock_guard<std::mutex> lock(errorMutex);
+				if(!error){
+					error=std::current_exception();
+				}
+				stop=true;
+			}
+		});
+	}
+
+	for(auto& worker : workers){
+		worker.join();
+	}
+
+	m_lineNumber=lastLineNumber;
+
+	if(error){
+		std::rethrow_exception(error);
+	}
+}
+
+//====================================================================
+
+JsonDocuments::JsonDocuments(const std::vector<JsonImpl*>& impls)
+{
+	m_documents.reserve(impls.size());
+	for(JsonImpl* impl : impls){
+		m_documents.emplace_back(new JsonObj(impl));
+	}
+}
+
+//--------------------------------------------------------------------
+
+size_t JsonDocuments::errorCount() const
+{
+	size_t count=0;
+	for(auto& document : m_documents){
+		if(!document->isValid()){
+			count++;
+		}
+	}
+
+	return count;
+}
+
+//====================================================================
+
+size_t JsonMemory::trim()
+{
+	return Allocator::Small_Object_Allocator::trim();
+}
+
+//--------------------------------------------------------------------
+
+void JsonMemory::setHighWatermark(size_t bytes)
+{
+	Allocator::Small_Object_Allocator::setHighWatermark(bytes);
+}
+
+//--------------------------------------------------------------------
+
+std::vector<JsonPoolStats> JsonMemory::poolStats()
+{
+	std::vector<JsonPoolStats> pools;
+	for(const auto& stats : Allocator::Small_Object_Allocator::stats()){
+		pools.push_back(JsonPoolStats{stats.m_blockSize, stats.m_liveBlocks, stats.m_freeBlocks, stats.m_chunks, stats.m_peakChunks});
+	}
+	return pools;
+}
+
+//====================================================================
@@ -6,120 +6,479 @@
 * Author:  Dan Machado                                               *
 **********************************************************************/
 #include "easyjson/internal/json_core.h"
+#include "easyjson/internal/event_parser.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifndef MAP_POPULATE
+#define MAP_POPULATE 0
+#endif
+#endif
 
 namespace easyjson{
 using namespace easyjson::internal;
 
 //--------------------------------------------------------------------
 
+JsonObjBuffer::~JsonObjBuffer()
+{
+	releaseMapping();
+	delete m_scopeMap;
+	delete m_keys;
+	delete m_arena;
+}
+
+//--------------------------------------------------------------------
+
+size_t JsonObjBuffer::scopeEnd(size_t first) const
+{
+	return m_scopeMap->scopeEnd(first);
+}
+
+//--------------------------------------------------------------------
+
+void JsonObjBuffer::releaseMapping()
+{
+	#ifndef _WIN32
+	if(m_mappedLength>0){
+		munmap(m_data, m_mappedLength);
+		m_mappedLength=0;
+	}
+	#endif
+}
+
+//--------------------------------------------------------------------
+
+JsonObjBuffer* JsonObjBuffer::mapFile(const char* fileName, size_t& fileLength, bool writable, size_t maxLength)
+{
+	fileLength=0;
+
+	#ifndef _WIN32
+	int fd=open(fileName, O_RDONLY);
+	if(fd<0){
+		return nullptr;
+	}
+
+	struct stat fileStat;
+	if(fstat(fd, &fileStat)!=0 || !S_ISREG(fileStat.st_mode)){
+		close(fd);
+		return nullptr;
+	}
+
+	fileLength=fileStat.st_size;
+	if(fileLength<2 || fileLength>maxLength){
+		close(fd);
+		return nullptr;
+	}
+
+	/*
+	 * Faulting a writable private mapping page by page costs more than
+	 * reading the file, it is populated in one go. Read only pages are
+	 * mapped several at a time around each fault, no need for that.
+	 * */
+	void* mapping=writable? mmap(nullptr, fileLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_POPULATE, fd, 0)
+		: mmap(nullptr, fileLength, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping keeps its own reference to the file
+
+	if(mapping==MAP_FAILED){
+		return nullptr;
+	}
+
+	madvise(mapping, fileLength, MADV_SEQUENTIAL);
+
+	#if defined(JSON_MMAP_HUGE_PAGES) && defined(MADV_HUGEPAGE)
+	// only a hint, the pages the parser writes to may be backed by huge pages
+	madvise(mapping, fileLength, MADV_HUGEPAGE);
+	#endif
+
+	JsonObjBuffer* bufferPtr=new JsonObjBuffer(static_cast<char*>(mapping), fileLength, in_situ());
+	bufferPtr->m_mappedLength=fileLength;
+
+	return bufferPtr;
+	#else
+	return nullptr;
+	#endif
+}
+
+//--------------------------------------------------------------------
+
 size_t JsonObjBuffer::addData(const char* data, size_t inOffset)
 {
 	size_t offset=inOffset;
 	if(offset>0){
 		size_t lengthOld=getLengthAt(offset);
 		size_t lengthNew=std::strlen(data);
-		if(lengthOld<=lengthNew){
-			std::memset(&m_buffer[offset], 0, lengthOld*sizeof(char));
-			std::memcpy(&m_buffer[offset], data, lengthNew*sizeof(char));
+		if(lengthNew<=lengthOld){
+			std::memset(m_data+offset, 0, lengthOld*sizeof(char));
+			std::memcpy(m_data+offset, data, lengthNew*sizeof(char));
 			return offset;
 		}
 	}
+
+	if(isInSitu()){
+		// the caller's buffer cannot grow, from now on the document owns a copy
+		m_buffer.assign(m_data, m_position);
+		releaseMapping();
+	}
 	
 	m_buffer+=" ";
 	m_buffer[m_position]=0;
 	offset=m_position+1;
 	m_buffer+=data;
 	m_position=m_buffer.length();
+	m_data=m_buffer.data();
 
 	return offset;
 }
 
 //--------------------------------------------------------------------
 
+void KeyTable::clear()
+{
+	m_entries.clear();
+	m_texts.clear();
+	m_sorted.clear();
+	std::fill(m_byText.begin(), m_byText.end(), 0);
+	std::fill(m_byOffset.begin(), m_byOffset.end(), Label{0, 0});
+}
+
+//--------------------------------------------------------------------
+
+uint32_t KeyTable::add(const char* key, size_t length, uint32_t h, uint32_t offset)
+{
+	m_entries.push_back({offset, uint32_t(m_texts.size()), uint32_t(length), h, 0});
+	m_texts.append(key, length);
+	const uint32_t idx=m_entries.size();
+
+	if(m_entries.size()*2>m_byText.size()){
+		grow();
+	}
+	else{
+		insertSlots(idx);
+	}
+
+	if(m_sorted.size()<c_MAX_LABELS){
+		setLabel(idx);
+	}
+
+	return idx;
+}
+
+//--------------------------------------------------------------------
+
+void KeyTable::setLabel(uint32_t idx)
+{
+	Entry& entry=m_entries[idx-1];
+	std::string_view text(m_texts.data()+entry.m_text, entry.m_length);
+
+	auto pos=std::lower_bound(m_sorted.begin(), m_sorted.end(), text, [this](uint32_t other, std::string_view text){
+		const Entry& entry=m_entries[other-1];
+		// as strcmp, the texts have no '\0'
+		return std::string_view(m_texts.data()+entry.m_text, entry.m_length)<text;
+	});
+	pos=m_sorted.insert(pos, idx);
+
+	// 0 and ~0 are never given
+	const uint64_t low=(pos==m_sorted.begin())? 0 : m_entries[*(pos-1)-1].m_label;
+	const uint64_t high=(pos+1==m_sorted.end())? ~uint64_t(0) : m_entries[*(pos+1)-1].m_label;
+
+	if(high-low>1){
+		setLabel(entry, low+(high-low)/2);
+	}
+	else{
+		const uint64_t step=~uint64_t(0)/(m_sorted.size()+1);
+		for(size_t i=0; i<m_sorted.size(); i++){
+			setLabel(m_entries[m_sorted[i]-1], step*(i+1));
+		}
+	}
+}
+
+//--------------------------------------------------------------------
+
+void KeyTable::setLabel(Entry& entry, uint64_t label)
+{
+	entry.m_label=label;
+
+	const size_t mask=m_byOffset.size()-1;
+	size_t i=mix(entry.m_offset) & mask;
+	while(m_byOffset[i].m_offset!=entry.m_offset){
+		i=(i+1) & mask;
+	}
+	m_byOffset[i].m_label=label;
+}
+
+//--------------------------------------------------------------------
+
+void KeyTable::insertSlots(uint32_t idx)
+{
+	const Entry& entry=m_entries[idx-1];
+	const size_t mask=m_byText.size()-1;
+
+	size_t i=entry.m_hash & mask;
+	while(m_byText[i]!=0){
+		i=(i+1) & mask;
+	}
+	m_byText[i]=idx;
+
+	i=mix(entry.m_offset) & mask;
+	while(m_byOffset[i].m_offset!=0){
+		i=(i+1) & mask;
+	}
+	m_byOffset[i]={entry.m_offset, entry.m_label};
+}
+
+//--------------------------------------------------------------------
+
+void KeyTable::grow()
+{
+	const size_t slots=m_byText.size()*2;
+	m_byText.assign(slots, 0);
+	m_byOffset.assign(slots, Label{0, 0});
+
+	for(uint32_t idx=1; idx<=m_entries.size(); idx++){
+		insertSlots(idx);
+	}
+}
+
+//--------------------------------------------------------------------
+
 NodeJson::~NodeJson()
 {
-	if(m_left){
-		NodeJson::freeNode(m_left);
-		m_left=nullptr;
+	if(left() && !isDecoded()){
+		NodeJson::freeNode(left());
+		setLeft(nullptr);
 	}
 
-	if(m_right){
-		NodeJson::freeNode(m_right);
-		m_right=nullptr;
+	if(right()){
+		NodeJson::freeNode(right());
+		setRight(nullptr);
 	}
 	
 	if(isArray()){
-		VectWrapper* vectPtr=reinterpret_cast<VectWrapper*>(m_child);
+		VectWrapper* vectPtr=vect();
 		s_vectPool.freeMem(vectPtr);
-		m_child=nullptr;
+		setChild(nullptr);
+	}
+	else if(isUnindexed()){
+		freeKeys();
 	}
-	else if(m_child){
-		NodeJson::freeNode(m_child);
+	else if(child()){
+		NodeJson::freeNode(child());
 	}
 
-	m_child=nullptr;
+	setChild(nullptr);
 }
 
 //--------------------------------------------------------------------
 
-void unescape(std::string& str, size_t initialPos)
+void NodeJson::freeKeys()
 {
-	size_t pos=initialPos;
-	while(pos!=std::string::npos){
-		pos=str.find_first_of('"', pos);
-		if(pos!=std::string::npos){
-			str.insert(pos, "\\");
-			pos+=2;
+	NodeJson* key=child();
+	while(key){
+		NodeJson* previous=key->left();
+		key->setLeft(nullptr);
+		NodeJson::freeNode(key);
+		key=previous;
+	}
+
+	setChild(nullptr);
+	setMode(NodeMode(mode() & ~NodeMode::Unindexed));
+}
+
+//--------------------------------------------------------------------
+/*
+ * Iterative, documents can be deeper than the stack. The siblings of
+ * the node itself (m_left and m_right of a key) are not counted.
+ * */
+
+void NodeJson::countNodes(size_t& nodes, size_t& vectors) const
+{
+	std::vector<const NodeJson*> pending;
+
+	auto descend=[&pending, &vectors](const NodeJson* node){
+		if(node->isArray()){
+			if(VectWrapper* vectPtr=node->vect()){
+				vectors++;
+				vectPtr->loop([&pending](size_t, NodeJson* item){
+					pending.push_back(item);
+				});
+			}
+		}
+		else if(node->child()){
+			pending.push_back(node->child());
 		}
+	};
+
+	nodes++;
+	descend(this);
+
+	while(!pending.empty()){
+		const NodeJson* node=pending.back();
+		pending.pop_back();
+
+		nodes++;
+		if(node->left() && !node->isDecoded()){
+			pending.push_back(node->left());
+		}
+		if(node->right()){
+			pending.push_back(node->right());
+		}
+		descend(node);
+	}
+}
+
+//--------------------------------------------------------------------
+
+/*
+ * The string as JSON text, without the quotes. Only strings flagged
+ * by isEscaped() go through here, the others are appended as they are.
+ * */
+void appendEscaped(std::string& str, const char* cstr)
+{
+	static const char hex[]="0123456789abcdef";
+
+	const char* run=cstr;
+	for(; *cstr; cstr++){
+		unsigned char c=*cstr;
+		if(c>=32 && c!='"' && c!='\\' && c!=0xC0 && c!=0xED){
+			continue;
+		}
+
+		str.append(run, cstr-run);
+		run=cstr+1;
+
+		switch(c){
+			case '"':
+				str+="\\\"";
+				break;
+			case '\\':
+				str+="\\\\";
+				break;
+			case '\b':
+				str+="\\b";
+				break;
+			case '\f':
+				str+="\\f";
+				break;
+			case '\n':
+				str+="\\n";
+				break;
+			case '\r':
+				str+="\\r";
+				break;
+			case '\t':
+				str+="\\t";
+				break;
+			case 0xC0:
+				if((unsigned char)cstr[1]==0x80){ // U+0000, see encodeUTF8
+					str+="\\u0000";
+					run=++cstr+1;
+				}
+				else{
+					str.push_back(char(c));
+				}
+				break;
+			case 0xED:
+				if((unsigned char)cstr[1]>=0xA0 && cstr[2]){ // a lone surrogate, see encodeUTF8
+					const unsigned codeUnit=0xD000 | (cstr[1] & 63)<<6 | (cstr[2] & 63);
+					str+="\\u";
+					for(int shift=12; shift>=0; shift-=4){
+						str.push_back(hex[(codeUnit>>shift) & 15]);
+					}
+					cstr+=2;
+					run=cstr+1;
+				}
+				else{
+					str.push_back(char(c));
+				}
+				break;
+			default:
+				str+="\\u00";
+				str.push_back(hex[c>>4]);
+				str.push_back(hex[c & 15]);
+		}
+	}
+	str.append(run, cstr-run);
+}
+
+void NodeJson::appendString(const JsonObjBuffer& jsonBufferRef, std::string& str) const
+{
+	if(isEscaped()){
+		appendEscaped(str, jsonBufferRef.getDataAt(m_offset));
+	}
+	else{
+		str+=jsonBufferRef.getDataAt(m_offset);
 	}
 }
 
 void NodeJson::printMore(const JsonObjBuffer& jsonBufferRef, const std::string& spacer, const int padding, std::string& str, int indentation) const
 {
 	str+=std::string(indentation, ' ')+"\"";
-	size_t p=str.length();
-	str+=jsonBufferRef.getDataAt(m_offset);
-	unescape(str, p);
+	appendString(jsonBufferRef, str);
 	str+="\"";
 	str+=": ";
-	if(m_child){
-		m_child->prettify(jsonBufferRef, str, indentation, spacer, padding);	
+	if(child()){
+		child()->prettify(jsonBufferRef, str, indentation, spacer, padding);	
 	}
 };
 
 void NodeJson::prettify(const JsonObjBuffer& jsonBufferRef, std::string& str, int indentation, const std::string& spacer, const int padding) const
 {
 	if(isKey()){
-		if(m_left){
-			m_left->prettify(jsonBufferRef, str, indentation, spacer, padding);	
+		if(left()){
+			left()->prettify(jsonBufferRef, str, indentation, spacer, padding);	
 			str+=", "+spacer;
 		}
 		printMore(jsonBufferRef, spacer, padding, str, indentation);
-		if(m_right){
+		if(right()){
 			str+=", "+spacer;
-			m_right->prettify(jsonBufferRef, str, indentation, spacer, padding);
+			right()->prettify(jsonBufferRef, str, indentation, spacer, padding);
 		}
 	}
+	else if(isLazy()){
+		// never accessed, so never parsed either: the text is still there
+		size_t last=jsonBufferRef.scopeEnd(m_offset);
+		str.append(jsonBufferRef.getDataAt(m_offset), last-m_offset+1);
+	}
 	else if(!isArray() && !isObj()){
 		if(m_offset>0){
-			if(m_dataMode==JSON_TYPES::_STR){
+			if(getDataMode()==JSON_TYPES::_STR){
 				str+="\"";
-			}
-			size_t p=str.length();
-			str+=jsonBufferRef.getDataAt(m_offset);
-			unescape(str, p);
-			if(m_dataMode==JSON_TYPES::_STR){
+				appendString(jsonBufferRef, str);
 				str+="\"";
 			}
+			else{
+				str+=jsonBufferRef.getDataAt(m_offset);
+			}
 		}
 		else{
 			throw "Incompleted...";
 		}
 	}
 	else if(isObj()){
-		if(m_child){
+		if(child() && isUnindexed()){
+			// in the order of the document, duplicates included
+			std::vector<const NodeJson*> keys;
+			for(const NodeJson* key=child(); key; key=key->left()){
+				keys.push_back(key);
+			}
+
 			str+="{"+spacer;
-			m_child->prettify(jsonBufferRef, str, indentation+padding, spacer, padding);
+			for(size_t i=keys.size(); i-->0;){
+				keys[i]->printMore(jsonBufferRef, spacer, padding, str, indentation+padding);
+				if(i>0){
+					str+=", "+spacer;
+				}
+			}
+			str+=spacer+std::string(indentation, ' ')+"}";
+		}
+		else if(child()){
+			str+="{"+spacer;
+			child()->prettify(jsonBufferRef, str, indentation+padding, spacer, padding);
 			/*if(m_child->m_left){
 				m_child->m_left->prettify(jsonBufferRef, str, indentation+padding, spacer, padding);
 				str+=", "+spacer;
@@ -136,11 +495,11 @@ void NodeJson::prettify(const JsonObjBuffer& jsonBufferRef, std::string& str, in
 		}
 	}
 	else if(isArray()){
-		if(m_child){
-			VectWrapper* triePtr=reinterpret_cast<VectWrapper*>(m_child);
+		if(child()){
+			VectWrapper* triePtr=vect();
 			if(triePtr->size()>0){
 				str+="["+spacer;
-				triePtr->loop([&str, jsonBufferRef, &spacer, padding, indentation](size_t i, NodeJson* node){
+				triePtr->loop([&str, &jsonBufferRef, &spacer, padding, indentation](size_t i, NodeJson* node){
 					if(i==0)
 					{
 						str+=std::string(indentation+padding, ' ');
@@ -176,36 +535,36 @@ void NodeJson::AVL_Tree::balance(NodeJson* node, int diff, NodeJson* top)
 		ft=-1;
 	}
 
-	NodeJson* tmp=node->*branch[clr];
-	NodeJson* tmp2=tmp->*branch[lr];
+	NodeJson* tmp=node->branch(clr);
+	NodeJson* tmp2=tmp->branch(lr);
 
 	bool isRoot=(m_root==node);
 
 	if(!tmp2){
 		node->bridge(tmp, top);
-		node->*branch[clr]=nullptr;
-		tmp->*branch[lr]=node;	
-		node->m_height-=2;
+		node->setBranch(clr, nullptr);
+		tmp->setBranch(lr, node);	
+		node->setHeight(node->height()-2);
 		tmp2=tmp;
 	}
 	else{
-		if(!(tmp->*branch[clr])){
+		if(!(tmp->branch(clr))){
 			node->bridge(tmp2, top);
 			
-			tmp2->*branch[lr]=node;
-			tmp2->*branch[clr]=tmp;
+			tmp2->setBranch(lr, node);
+			tmp2->setBranch(clr, tmp);
 			
-			tmp->*branch[lr]=nullptr;
-			node->*branch[clr]=nullptr;
-			node->m_height=0;
-			tmp->m_height=0;
-			tmp2->m_height=1;
+			tmp->setBranch(lr, nullptr);
+			node->setBranch(clr, nullptr);
+			node->setHeight(0);
+			tmp->setHeight(0);
+			tmp2->setHeight(1);
 		}
 		else if(ft*tmp->diff()>0){
 			node->bridge(tmp, top);
 
-			tmp->*branch[lr]=node;
-			node->*branch[clr]=tmp2;
+			tmp->setBranch(lr, node);
+			node->setBranch(clr, tmp2);
 
 			node->updateHeight();
 			tmp->updateHeight();
@@ -213,11 +572,11 @@ void NodeJson::AVL_Tree::balance(NodeJson* node, int diff, NodeJson* top)
 		}
 		else{
 			node->bridge(tmp2, top);
-			node->*branch[clr]=tmp2->*branch[lr];
+			node->setBranch(clr, tmp2->branch(lr));
 
-			tmp2->*branch[lr]=node;
-			tmp->*branch[lr]=tmp2->*branch[clr];
-			tmp2->*branch[clr]=tmp;
+			tmp2->setBranch(lr, node);
+			tmp->setBranch(lr, tmp2->branch(clr));
+			tmp2->setBranch(clr, tmp);
 
 			node->updateHeight();
 			tmp->updateHeight();
@@ -234,38 +593,47 @@ void NodeJson::AVL_Tree::balance(NodeJson* node, int diff, NodeJson* top)
 
 int16_t NodeJson::AVL_Tree::insert(NodeJson* root, NodeJson* node, NodeJson* top)
 {
-	int y=m_jsonBufferRef.compare(node->m_offset, root->m_offset);
+	const KeyTable* keys=m_jsonBufferRef.keys();
+	int y=keys? keys->compare(m_jsonBufferRef.getDataAt(0), node->m_offset, root->m_offset) : m_jsonBufferRef.compare(node->m_offset, root->m_offset);
 
 	int16_t x=1;
 
 	if(y<0){	
-		if(root->m_left){
-			x=x+insert(root->m_left, node, root);
+		if(root->left()){
+			int16_t h=insert(root->left(), node, root);
+			if(h<0){ // duplicate key further down
+				return -1;
+			}
+			x=x+h;
 		}
 		else{
-			root->m_left=node;
+			root->setLeft(node);
 		}
 	}
 	else if(y>0){
-		if(root->m_right){
-			x=x+insert(root->m_right, node, root);
+		if(root->right()){
+			int16_t h=insert(root->right(), node, root);
+			if(h<0){ // duplicate key further down
+				return -1;
+			}
+			x=x+h;
 		}
 		else{
-			root->m_right=node;
+			root->setRight(node);
 		}
 	}
 	else{
 		return -1;
 	}
 	
-	root->m_height=std::max(root->m_height, x);
+	root->setHeight(std::max(root->height(), x));
 
 	int diff=root->diff();
 	if(std::abs(diff)>1){
 		balance(root, diff, top);
 	}
 	
-	return root->m_height;
+	return root->height();
 }
 
 //--------------------------------------------------------------------
@@ -274,7 +642,7 @@ void NodeJson::AVL_Tree::removeNode(NodeJson* node, NodeJson* top)
 {
 	int diff=node->diff();
 	int lr, clr;
-	if(diff>0 || (diff==0 && node->m_right)){
+	if(diff>0 || (diff==0 && node->right())){
 		lr=LR::LEFT;
 		clr=LR::RIGHT;
 	}
@@ -287,43 +655,43 @@ void NodeJson::AVL_Tree::removeNode(NodeJson* node, NodeJson* top)
 	
 	NodeJson* tmp=nullptr;
 
-	if(!node->m_right && !node->m_left){
+	if(!node->right() && !node->left()){
 		if(isRoot){
 			m_root=nullptr;
 			NodeJson::freeNode(node);
 			return;
 		}
 
-		if(top->m_right==node){
-			top->m_right=nullptr;
+		if(top->right()==node){
+			top->setRight(nullptr);
 		}
 		else{
-			top->m_left=nullptr;
+			top->setLeft(nullptr);
 		}
 		tmp=top;
 	}
 	else{
 		NodeJson* tmpTop=node;
-		tmp=node->*branch[clr];
-		while(tmp->*branch[lr]){
+		tmp=node->branch(clr);
+		while(tmp->branch(lr)){
 			tmpTop=tmp;
-			tmp=tmp->*branch[lr];
+			tmp=tmp->branch(lr);
 		}
 
 		if(tmpTop==node){
 			node->bridge(tmp, top);
-			tmp->*branch[lr]=node->*branch[lr];
+			tmp->setBranch(lr, node->branch(lr));
 		}
 		else{
-			tmpTop->*branch[lr]=tmp->*branch[clr];
+			tmpTop->setBranch(lr, tmp->branch(clr));
 
 			node->bridge(tmp, top);
-			tmp->*branch[lr]=node->*branch[lr];
-			tmp->*branch[clr]=node->*branch[clr];
+			tmp->setBranch(lr, node->branch(lr));
+			tmp->setBranch(clr, node->branch(clr));
 		}
 
-		node->*branch[lr]=nullptr;
-		node->*branch[clr]=nullptr;
+		node->setBranch(lr, nullptr);
+		node->setBranch(clr, nullptr);
 	}
 
 	if(isRoot){
@@ -360,8 +728,8 @@ bool NodeJson::AVL_Tree::removeNode(const char* key, NodeJson* node, NodeJson* t
 		return true;
 	}
 
-	if(m_root && node->*branch[br]){
-		if(!removeNode(key, node->*branch[br], node)){
+	if(m_root && node->branch(br)){
+		if(!removeNode(key, node->branch(br), node)){
 			node->updateHeight();
 			int diff=node->diff();
 			if(node!=top && std::abs(diff)>1){
@@ -376,11 +744,70 @@ bool NodeJson::AVL_Tree::removeNode(const char* key, NodeJson* node, NodeJson* t
 
 void NodeJson::AVL_Tree::remove(const char* key, NodeJson* obj)
 {
-	m_root=obj->m_child;
+	if(obj->isUnindexed()){
+		buildIndex(m_jsonBufferRef, obj);
+	}
+
+	m_root=obj->child();
 	if(m_root){
 		removeNode(key, m_root, nullptr);
-		obj->m_child=m_root;
+		obj->setChild(m_root);
+	}
+}
+
+//--------------------------------------------------------------------
+
+void NodeJson::AVL_Tree::buildIndex(const JsonObjBuffer& jsonBufferRef, NodeJson* obj)
+{
+	std::vector<NodeJson*> keys;
+	NodeJson* key=obj->child();
+	while(key){
+		keys.push_back(key);
+		key=key->left();
+		keys.back()->setLeft(nullptr);
+	}
+
+	// back in the order of the document, which the sort keeps among equal keys
+	std::reverse(keys.begin(), keys.end());
+
+	const KeyTable* table=jsonBufferRef.keys();
+	const char* buffer=jsonBufferRef.getDataAt(0);
+	auto compare=[table, buffer, &jsonBufferRef](const NodeJson* left, const NodeJson* right){
+		return table? table->compare(buffer, left->m_offset, right->m_offset) : jsonBufferRef.compare(left->m_offset, right->m_offset);
+	};
+
+	std::stable_sort(keys.begin(), keys.end(), [&compare](const NodeJson* left, const NodeJson* right){
+		return compare(left, right)<0;
+	});
+
+	size_t count=0;
+	for(size_t i=0; i<keys.size(); i++){
+		if(i+1<keys.size() && compare(keys[i], keys[i+1])==0){
+			NodeJson::freeNode(keys[i]);
+			continue;
+		}
+		keys[count++]=keys[i];
 	}
+
+	obj->setChild(link(keys.data(), count));
+	obj->setMode(NodeMode(obj->mode() & ~NodeMode::Unindexed));
+}
+
+//--------------------------------------------------------------------
+
+NodeJson* NodeJson::AVL_Tree::link(NodeJson** keys, size_t count)
+{
+	if(count==0){
+		return nullptr;
+	}
+
+	const size_t middle=count/2;
+	NodeJson* root=keys[middle];
+	root->setLeft(link(keys, middle));
+	root->setRight(link(keys+middle+1, count-middle-1));
+	root->updateHeight();
+
+	return root;
 }
 
 //====================================================================
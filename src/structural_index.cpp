@@ -0,0 +1,790 @@
+/*********************************************************************
+* Implementation of StructuralIndex class                     		*
+*                                                                    *
+* Version: 1.0                                                       *
+* Date:    17-10-2026                                                *
+* Author:  Dan Machado                                               *
+**********************************************************************/
+#include "easyjson/internal/structural_index.h"
+
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+	#include <immintrin.h>
+#endif
+
+namespace easyjson{
+using namespace easyjson::internal;
+
+//--------------------------------------------------------------------
+
+namespace
+{
+	struct BlockMasks
+	{
+		uint64_t m_quote;
+		uint64_t m_backslash;
+		uint64_t m_operator;
+		uint64_t m_whitespace;
+		uint64_t m_control;
+		uint64_t m_open; // '{' and '[', only the pre-scan of parallel parsing needs them
+		uint64_t m_close;
+	};
+
+#if defined(__AVX2__)
+
+	inline uint64_t toMask(__m256i lo, __m256i hi) __attribute__((always_inline));
+	inline uint64_t toMask(__m256i lo, __m256i hi)
+	{
+		return uint64_t(uint32_t(_mm256_movemask_epi8(lo))) | (uint64_t(uint32_t(_mm256_movemask_epi8(hi)))<<32);
+	}
+
+	inline void classify(const char* src, BlockMasks& masks) __attribute__((always_inline));
+	inline void classify(const char* src, BlockMasks& masks)
+	{
+		const __m256i lo=_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+		const __m256i hi=_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src+32));
+
+		const __m256i quote=_mm256_set1_epi8('"');
+		const __m256i backslash=_mm256_set1_epi8('\\');
+		const __m256i space=_mm256_set1_epi8(33);
+		const __m256i control=_mm256_set1_epi8(14);
+		const __m256i minusOne=_mm256_set1_epi8(-1);
+
+		// '[' | 0x20 == '{' and ']' | 0x20 == '}'
+		const __m256i caseBit=_mm256_set1_epi8(0x20);
+		const __m256i curlOpen=_mm256_set1_epi8('{');
+		const __m256i curlClose=_mm256_set1_epi8('}');
+		const __m256i colon=_mm256_set1_epi8(':');
+		const __m256i comma=_mm256_set1_epi8(',');
+
+		const __m256i foldedLo=_mm256_or_si256(lo, caseBit);
+		const __m256i foldedHi=_mm256_or_si256(hi, caseBit);
+		const __m256i openLo=_mm256_cmpeq_epi8(foldedLo, curlOpen);
+		const __m256i openHi=_mm256_cmpeq_epi8(foldedHi, curlOpen);
+		const __m256i closeLo=_mm256_cmpeq_epi8(foldedLo, curlClose);
+		const __m256i closeHi=_mm256_cmpeq_epi8(foldedHi, curlClose);
+
+		auto ops=[&](__m256i v, __m256i open, __m256i close){
+			return _mm256_or_si256(
+				_mm256_or_si256(open, close),
+				_mm256_or_si256(_mm256_cmpeq_epi8(v, colon), _mm256_cmpeq_epi8(v, comma))
+			);
+		};
+
+		auto ctrl=[&](__m256i v){
+			return _mm256_and_si256(_mm256_cmpgt_epi8(control, v), _mm256_cmpgt_epi8(v, minusOne));
+		};
+
+		masks.m_quote=toMask(_mm256_cmpeq_epi8(lo, quote), _mm256_cmpeq_epi8(hi, quote));
+		masks.m_backslash=toMask(_mm256_cmpeq_epi8(lo, backslash), _mm256_cmpeq_epi8(hi, backslash));
+		masks.m_operator=toMask(ops(lo, openLo, closeLo), ops(hi, openHi, closeHi));
+		masks.m_whitespace=toMask(_mm256_cmpgt_epi8(space, lo), _mm256_cmpgt_epi8(space, hi));
+		masks.m_control=toMask(ctrl(lo), ctrl(hi));
+		masks.m_open=toMask(openLo, openHi);
+		masks.m_close=toMask(closeLo, closeHi);
+	}
+
+#elif defined(__SSE2__)
+
+	inline uint64_t toMask(__m128i a, __m128i b, __m128i c, __m128i d) __attribute__((always_inline));
+	inline uint64_t toMask(__m128i a, __m128i b, __m128i c, __m128i d)
+	{
+		return uint64_t(uint16_t(_mm_movemask_epi8(a)))
+			| (uint64_t(uint16_t(_mm_movemask_epi8(b)))<<16)
+			| (uint64_t(uint16_t(_mm_movemask_epi8(c)))<<32)
+			| (uint64_t(uint16_t(_mm_movemask_epi8(d)))<<48);
+	}
+
+	inline void classify(const char* src, BlockMasks& masks) __attribute__((always_inline));
+	inline void classify(const char* src, BlockMasks& masks)
+	{
+		__m128i v[4];
+		for(int i=0; i<4; i++){
+			v[i]=_mm_loadu_si128(reinterpret_cast<const __m128i*>(src+16*i));
+		}
+
+		const __m128i quote=_mm_set1_epi8('"');
+		const __m128i backslash=_mm_set1_epi8('\\');
+		const __m128i space=_mm_set1_epi8(33);
+		const __m128i control=_mm_set1_epi8(14);
+		const __m128i minusOne=_mm_set1_epi8(-1);
+
+		const __m128i caseBit=_mm_set1_epi8(0x20);
+		const __m128i curlOpen=_mm_set1_epi8('{');
+		const __m128i curlClose=_mm_set1_epi8('}');
+		const __m128i colon=_mm_set1_epi8(':');
+		const __m128i comma=_mm_set1_epi8(',');
+
+		__m128i q[4], b[4], o[4], w[4], c[4], op[4], cl[4];
+		for(int i=0; i<4; i++){
+			const __m128i folded=_mm_or_si128(v[i], caseBit);
+			q[i]=_mm_cmpeq_epi8(v[i], quote);
+			b[i]=_mm_cmpeq_epi8(v[i], backslash);
+			op[i]=_mm_cmpeq_epi8(folded, curlOpen);
+			cl[i]=_mm_cmpeq_epi8(folded, curlClose);
+			o[i]=_mm_or_si128(
+				_mm_or_si128(op[i], cl[i]),
+				_mm_or_si128(_mm_cmpeq_epi8(v[i], colon), _mm_cmpeq_epi8(v[i], comma))
+			);
+			w[i]=_mm_cmplt_epi8(v[i], space);
+			c[i]=_mm_and_si128(_mm_cmplt_epi8(v[i], control), _mm_cmpgt_epi8(v[i], minusOne));
+		}
+
+		masks.m_quote=toMask(q[0], q[1], q[2], q[3]);
+		masks.m_backslash=toMask(b[0], b[1], b[2], b[3]);
+		masks.m_operator=toMask(o[0], o[1], o[2], o[3]);
+		masks.m_whitespace=toMask(w[0], w[1], w[2], w[3]);
+		masks.m_control=toMask(c[0], c[1], c[2], c[3]);
+		masks.m_open=toMask(op[0], op[1], op[2], op[3]);
+		masks.m_close=toMask(cl[0], cl[1], cl[2], cl[3]);
+	}
+
+#else
+
+	inline void classify(const char* src, BlockMasks& masks)
+	{
+		masks={0, 0, 0, 0, 0, 0, 0};
+		for(int i=0; i<64; i++){
+			const uint64_t bit=uint64_t(1)<<i;
+			const signed char c=src[i];
+			switch(c){
+				case '"':
+					masks.m_quote|=bit;
+					break;
+				case '\\':
+					masks.m_backslash|=bit;
+					break;
+				case '{':
+				case '[':
+					masks.m_operator|=bit;
+					masks.m_open|=bit;
+					break;
+				case '}':
+				case ']':
+					masks.m_operator|=bit;
+					masks.m_close|=bit;
+					break;
+				case ':':
+				case ',':
+					masks.m_operator|=bit;
+					break;
+				default:
+					if(c<33){
+						masks.m_whitespace|=bit;
+						if(c>=0 && c<14){
+							masks.m_control|=bit;
+						}
+					}
+					break;
+			}
+		}
+	}
+
+#endif
+
+	/*
+	 * Bits set at every position preceded by an odd run of backslashes,
+	 * i.e. characters that are escaped. prevEscaped carries a pending
+	 * escape into the next block.
+	 * */
+	inline uint64_t findEscaped(uint64_t backslash, uint64_t& prevEscaped) __attribute__((always_inline));
+	inline uint64_t findEscaped(uint64_t backslash, uint64_t& prevEscaped)
+	{
+		if(!backslash){
+			uint64_t escaped=prevEscaped;
+			prevEscaped=0;
+			return escaped;
+		}
+
+		const uint64_t evenBits=0x5555555555555555ULL;
+		const uint64_t oddBits=~evenBits;
+
+		uint64_t startEdges=backslash & ~(backslash<<1);
+		uint64_t evenStartMask=evenBits ^ prevEscaped;
+		uint64_t evenStarts=startEdges & evenStartMask;
+		uint64_t oddStarts=startEdges & ~evenStartMask;
+		uint64_t evenCarries=backslash+evenStarts;
+
+		uint64_t oddCarries;
+		bool endsOdd=__builtin_add_overflow(backslash, oddStarts, &oddCarries);
+		oddCarries|=prevEscaped;
+		prevEscaped=endsOdd? 1 : 0;
+
+		uint64_t evenCarryEnds=evenCarries & ~backslash;
+		uint64_t oddCarryEnds=oddCarries & ~backslash;
+
+		return (evenCarryEnds & oddBits) | (oddCarryEnds & evenBits);
+	}
+
+	/*
+	 * Bit i of the result is the xor of the bits 0..i of x.
+	 * */
+	inline uint64_t prefixXor(uint64_t x) __attribute__((always_inline));
+	inline uint64_t prefixXor(uint64_t x)
+	{
+		#if defined(__PCLMUL__)
+			return uint64_t(_mm_cvtsi128_si64(_mm_clmulepi64_si128(_mm_set_epi64x(0, x), _mm_set1_epi8(char(0xFF)), 0)));
+		#else
+			x^=x<<1;
+			x^=x<<2;
+			x^=x<<4;
+			x^=x<<8;
+			x^=x<<16;
+			x^=x<<32;
+			return x;
+		#endif
+	}
+
+	/*
+	 * Offset of the first byte of the first invalid UTF-8 sequence
+	 * among the ones that start in [first, last) (a sequence that
+	 * runs into first from before is included), or
+	 * StructuralIndex::c_VALID. A sequence cut short by the end of the
+	 * buffer (length) is invalid.
+	 * */
+	size_t findInvalidUTF8(const char* buffer, size_t first, size_t last, size_t length)
+	{
+		const unsigned char* src=reinterpret_cast<const unsigned char*>(buffer);
+
+		size_t i=first;
+		for(size_t j=first; j>0 && j+3>first; j--){
+			if(src[j-1]<0x80){
+				break;
+			}
+			if(src[j-1]>=0xC0){
+				i=j-1;
+				break;
+			}
+		}
+
+		if(last>length){
+			last=length;
+		}
+
+		while(i<last){
+			const unsigned char c=src[i];
+			if(c<0x80){
+				i++;
+				continue;
+			}
+
+			// the range of the second byte rules out overlong forms, surrogates and anything above U+10FFFF
+			size_t size;
+			unsigned char low=0x80;
+			unsigned char high=0xBF;
+			if(c<0xC2){
+				return i;
+			}
+			else if(c<0xE0){
+				size=2;
+			}
+			else if(c<0xF0){
+				size=3;
+				if(c==0xE0){
+					low=0xA0;
+				}
+				else if(c==0xED){
+					high=0x9F;
+				}
+			}
+			else if(c<0xF5){
+				size=4;
+				if(c==0xF0){
+					low=0x90;
+				}
+				else if(c==0xF4){
+					high=0x8F;
+				}
+			}
+			else{
+				return i;
+			}
+
+			if(i+size>length || src[i+1]<low || src[i+1]>high){
+				return i;
+			}
+			for(size_t n=2; n<size; n++){
+				if((src[i+n] & 0xC0)!=0x80){
+					return i;
+				}
+			}
+			i+=size;
+		}
+
+		return StructuralIndex::c_VALID;
+	}
+
+	/*
+	 * Whether the last bytes of a block (tail holds bytes 60 to 63)
+	 * leave a sequence open.
+	 * */
+	inline bool incompleteUTF8(uint32_t tail) __attribute__((always_inline));
+	inline bool incompleteUTF8(uint32_t tail)
+	{
+		return (tail>>24)>=0xC0 || ((tail>>16) & 0xFF)>=0xE0 || ((tail>>8) & 0xFF)>=0xF0;
+	}
+
+#if defined(__AVX2__)
+
+	/*
+	 * UTF-8 check by table lookup (Keiser and Lemire): every byte is
+	 * classified from the high nibble of the byte before it, the low
+	 * nibble of the byte before it and its own high nibble, the three
+	 * results only have a bit in common when the pair is invalid.
+	 * A continuation byte the lookup cannot tell about (the 3rd and
+	 * 4th of a sequence) is matched against the lead 2 or 3 bytes back.
+	 * */
+	constexpr char c_TOO_SHORT=1<<0;   // 11______ 0_______ or 11______ 11______
+	constexpr char c_TOO_LONG=1<<1;    // 0_______ 10______
+	constexpr char c_OVERLONG_3=1<<2;  // 11100000 100_____
+	constexpr char c_TOO_LARGE=1<<3;   // 11110100 1001____ and above
+	constexpr char c_SURROGATE=1<<4;   // 11101101 101_____
+	constexpr char c_OVERLONG_2=1<<5;  // 1100000_ 10______
+	constexpr char c_OVERLONG_4=1<<6;  // 11110000 1000____
+	constexpr char c_TOO_LARGE_1000=1<<6; // 11110101 1000____ and above
+	constexpr char c_TWO_CONTS=char(1<<7); // 10______ 10______
+	constexpr char c_CARRY=c_TOO_SHORT | c_TOO_LONG | c_TWO_CONTS;
+
+	// the input shifted by N bytes, the first ones taken from the end of prev
+	template<int N>
+	inline __m256i previous(__m256i input, __m256i prev) __attribute__((always_inline));
+	template<int N>
+	inline __m256i previous(__m256i input, __m256i prev)
+	{
+		return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16-N);
+	}
+
+	inline __m256i lookup(__m128i table, __m256i index) __attribute__((always_inline));
+	inline __m256i lookup(__m128i table, __m256i index)
+	{
+		return _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(table), index);
+	}
+
+	inline __m256i utf8Errors(__m256i input, __m256i prev) __attribute__((always_inline));
+	inline __m256i utf8Errors(__m256i input, __m256i prev)
+	{
+		const __m256i nibble=_mm256_set1_epi8(0x0F);
+		const __m256i prev1=previous<1>(input, prev);
+
+		const __m256i byte1High=lookup(_mm_setr_epi8(
+			c_TOO_LONG, c_TOO_LONG, c_TOO_LONG, c_TOO_LONG,
+			c_TOO_LONG, c_TOO_LONG, c_TOO_LONG, c_TOO_LONG,
+			c_TWO_CONTS, c_TWO_CONTS, c_TWO_CONTS, c_TWO_CONTS,
+			c_TOO_SHORT | c_OVERLONG_2,
+			c_TOO_SHORT,
+			c_TOO_SHORT | c_OVERLONG_3 | c_SURROGATE,
+			c_TOO_SHORT | c_TOO_LARGE | c_TOO_LARGE_1000 | c_OVERLONG_4
+		), _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+
+		const __m256i byte1Low=lookup(_mm_setr_epi8(
+			c_CARRY | c_OVERLONG_3 | c_OVERLONG_2 | c_OVERLONG_4,
+			c_CARRY | c_OVERLONG_2,
+			c_CARRY,
+			c_CARRY,
+			c_CARRY | c_TOO_LARGE,
+			c_CARRY | c_TOO_LARGE | c_TOO_LARGE_1000,
+			c_CARRY | c_TOO_LARGE | c_TOO_LARGE_1000,
+			c_CARRY | c_TOO_LARGE | c_TOO_LARGE_1000,
+			c_CARRY | c_TOO_LARGE | c_TOO_LARGE_1000,
+			c_CARRY | c_TOO_LARGE | c_TOO_LARGE_1000,
+			c_CARRY | c_TOO_LARGE | c_TOO_LARGE_1000,
+			c_CARRY | c_TOO_LARGE | c_TOO_LARGE_1000,
+			c_CARRY | c_TOO_LARGE | c_TOO_LARGE_1000,
+			c_CARRY | c_TOO_LARGE | c_TOO_LARGE_1000 | c_SURROGATE,
+			c_CARRY | c_TOO_LARGE | c_TOO_LARGE_1000,
+			c_CARRY | c_TOO_LARGE | c_TOO_LARGE_1000
+		), _mm256_and_si256(prev1, nibble));
+
+		const __m256i byte2High=lookup(_mm_setr_epi8(
+			c_TOO_SHORT, c_TOO_SHORT, c_TOO_SHORT, c_TOO_SHORT,
+			c_TOO_SHORT, c_TOO_SHORT, c_TOO_SHORT, c_TOO_SHORT,
+			c_TOO_LONG | c_OVERLONG_2 | c_TWO_CONTS | c_OVERLONG_3 | c_TOO_LARGE_1000 | c_OVERLONG_4,
+			c_TOO_LONG | c_OVERLONG_2 | c_TWO_CONTS | c_OVERLONG_3 | c_TOO_LARGE,
+			c_TOO_LONG | c_OVERLONG_2 | c_TWO_CONTS | c_SURROGATE | c_TOO_LARGE,
+			c_TOO_LONG | c_OVERLONG_2 | c_TWO_CONTS | c_SURROGATE | c_TOO_LARGE,
+			c_TOO_SHORT, c_TOO_SHORT, c_TOO_SHORT, c_TOO_SHORT
+		), _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble));
+
+		const __m256i special=_mm256_and_si256(_mm256_and_si256(byte1High, byte1Low), byte2High);
+
+		// only 111_____ and 1111____ are left with the high bit set
+		const __m256i third=_mm256_subs_epu8(previous<2>(input, prev), _mm256_set1_epi8(char(0xE0-0x80)));
+		const __m256i fourth=_mm256_subs_epu8(previous<3>(input, prev), _mm256_set1_epi8(char(0xF0-0x80)));
+		const __m256i must23=_mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(char(0x80)));
+
+		return _mm256_xor_si256(must23, special);
+	}
+
+	/*
+	 * False when the block is not valid UTF-8 taking into account the
+	 * last bytes of the previous block (tail), which are replaced with
+	 * the ones of this block.
+	 * */
+	inline bool validUTF8(const char* src, uint32_t& tail) __attribute__((always_inline));
+	inline bool validUTF8(const char* src, uint32_t& tail)
+	{
+		const __m256i lo=_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+		const __m256i hi=_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src+32));
+
+		if(!_mm256_movemask_epi8(_mm256_or_si256(lo, hi))){// ASCII
+			const bool incomplete=incompleteUTF8(tail);
+			tail=0;
+			return !incomplete;
+		}
+
+		const __m256i prev=_mm256_insert_epi32(_mm256_setzero_si256(), int(tail), 7);
+		const __m256i errors=_mm256_or_si256(utf8Errors(lo, prev), utf8Errors(hi, lo));
+		std::memcpy(&tail, src+60, sizeof(tail));
+
+		return _mm256_testz_si256(errors, errors);
+	}
+
+#else
+
+	/*
+	 * Without AVX2 only plain ASCII blocks pass here, any other one
+	 * goes through findInvalidUTF8, which reads past the end of the
+	 * block to complete the last sequence, so nothing is carried (tail
+	 * stays 0).
+	 * */
+	inline bool validUTF8(const char* src, uint32_t& tail) __attribute__((always_inline));
+	inline bool validUTF8(const char* src, uint32_t&)
+	{
+		uint64_t bits=0;
+		for(int i=0; i<8; i++){
+			uint64_t word;
+			std::memcpy(&word, src+8*i, sizeof(word));
+			bits|=word;
+		}
+		return !(bits & 0x8080808080808080ULL);
+	}
+
+#endif
+}
+
+//--------------------------------------------------------------------
+
+void StructuralIndex::indexBlock(const char* block, uint32_t offset)
+{
+	BlockMasks masks;
+	classify(block, masks);
+
+	if(m_validateUTF8 && !validUTF8(block, m_utf8Tail)){
+		m_utf8Error=findInvalidUTF8(m_buffer, offset, offset+c_BLOCK, m_length);
+	}
+
+	uint64_t escaped=findEscaped(masks.m_backslash, m_prevEscaped);
+	uint64_t quote=masks.m_quote & ~escaped;
+
+	// from the opening quote (included) to the closing one (excluded)
+	uint64_t inString=prefixXor(quote) ^ m_prevInString;
+	m_prevInString=uint64_t(int64_t(inString)>>63);
+
+	uint64_t dirty=(masks.m_backslash | masks.m_control) & inString & ~quote;
+
+	uint64_t scalar=~(masks.m_operator | masks.m_whitespace | quote | inString);
+	uint64_t scalarStart=scalar & ~((scalar<<1) | m_prevScalar);
+	m_prevScalar=scalar>>63;
+
+	uint64_t operators=masks.m_operator & ~inString;
+	if(operators){
+		m_safeEnd=offset+64-__builtin_clzll(operators);
+	}
+
+	uint64_t structural=operators | quote | scalarStart;
+
+	uint32_t* entries=m_entries+m_count;
+
+	if(!dirty && !m_dirtyString){
+		while(structural){
+			*entries++=offset+__builtin_ctzll(structural);
+			structural&=structural-1;
+		}
+	}
+	else{
+		uint64_t closing=quote & ~inString;
+		uint64_t bits=structural | dirty;
+		while(bits){
+			int pos=__builtin_ctzll(bits);
+			uint64_t bit=uint64_t(1)<<pos;
+			if(dirty & bit){
+				m_dirtyString=true;
+			}
+			else{
+				uint32_t entry=offset+pos;
+				if((closing & bit) && m_dirtyString){
+					entry|=c_DIRTY;
+					m_dirtyString=false;
+				}
+				*entries++=entry;
+			}
+			bits&=bits-1;
+		}
+	}
+
+	m_count=entries-m_entries;
+
+	if(m_utf8Error!=c_VALID){
+		while(m_count>0 && (m_entries[m_count-1] & ~c_DIRTY)>=m_utf8Error){
+			m_count--;
+		}
+	}
+}
+
+//--------------------------------------------------------------------
+
+/*
+ * A sequence still open after the last block: when the length is a
+ * multiple of c_BLOCK there is no tail block padded with spaces to
+ * catch it.
+ * */
+void StructuralIndex::finishUTF8()
+{
+	if(m_validateUTF8 && m_utf8Error==c_VALID && incompleteUTF8(m_utf8Tail)){
+		m_utf8Error=findInvalidUTF8(m_buffer, m_length-3, m_length, m_length);
+	}
+}
+
+//--------------------------------------------------------------------
+
+bool StructuralIndex::refill()
+{
+	if(m_streaming || m_indexed>m_count){
+		return refillStream();
+	}
+
+	m_count=0;
+	m_current=0;
+
+	// a window made only of whitespace or string contents yields no entries
+	while(m_count==0 && m_position<m_length && m_utf8Error==c_VALID){
+		for(size_t blocks=0; m_position<m_length && blocks<c_WINDOW && m_utf8Error==c_VALID; blocks++){
+			if(m_position+c_BLOCK<=m_length){
+				indexBlock(m_buffer+m_position, m_position);
+			}
+			else{
+				// the last chunk is padded with spaces, so we never read beyond the buffer
+				char tail[c_BLOCK];
+				std::memset(tail, ' ', c_BLOCK);
+				std::memcpy(tail, m_buffer+m_position, m_length-m_position);
+				indexBlock(tail, m_position);
+			}
+			m_position+=c_BLOCK;
+		}
+	}
+
+	if(m_position>=m_length){
+		finishUTF8();
+	}
+
+	m_indexed=m_count;
+
+	return m_count>0;
+}
+
+//--------------------------------------------------------------------
+
+bool StructuralIndex::refillStream()
+{
+	// what was held back goes to the front of the window
+	uint32_t held=m_indexed-m_count;
+	std::memmove(m_entries, m_entries+m_count, held*sizeof(uint32_t));
+	m_count=held;
+	m_current=0;
+
+	const uint32_t capacity=c_WINDOW*c_BLOCK;
+
+	// a block adds at most c_BLOCK entries
+	while(m_count+c_BLOCK<=capacity && m_position+c_BLOCK<=m_length && m_utf8Error==c_VALID){
+		indexBlock(m_buffer+m_position, m_position);
+		m_position+=c_BLOCK;
+	}
+
+	if(!m_streaming && m_count+c_BLOCK<=capacity && m_position<m_length && m_utf8Error==c_VALID){
+		char tail[c_BLOCK];
+		std::memset(tail, ' ', c_BLOCK);
+		std::memcpy(tail, m_buffer+m_position, m_length-m_position);
+		indexBlock(tail, m_position);
+		m_position=m_length;
+	}
+
+	if(!m_streaming && m_position>=m_length){
+		finishUTF8();
+	}
+
+	m_indexed=m_count;
+
+	if((m_streaming || m_position<m_length) && m_utf8Error==c_VALID){
+		while(m_count>0 && (m_entries[m_count-1] & ~c_DIRTY)>=m_safeEnd){
+			m_count--;
+		}
+
+		if(m_count==0 && m_indexed+c_BLOCK>capacity){
+			/*
+			 * A full window without a single operator is not valid JSON,
+			 * stage 2 fails within the first few entries anyway.
+			 * */
+			m_count=m_indexed;
+		}
+	}
+
+	return m_count>0;
+}
+
+//--------------------------------------------------------------------
+
+const char* internal::findEscapeOrControl(const char* first, const char* last)
+{
+	#if defined(__AVX2__)
+		const __m256i backslash=_mm256_set1_epi8('\\');
+		const __m256i control=_mm256_set1_epi8(14);
+		const __m256i minusOne=_mm256_set1_epi8(-1);
+
+		while(last-first>=32){
+			const __m256i v=_mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+			const __m256i special=_mm256_or_si256(
+				_mm256_cmpeq_epi8(v, backslash),
+				_mm256_and_si256(_mm256_cmpgt_epi8(control, v), _mm256_cmpgt_epi8(v, minusOne))
+			);
+			uint32_t mask=_mm256_movemask_epi8(special);
+			if(mask){
+				return first+__builtin_ctz(mask);
+			}
+			first+=32;
+		}
+	#elif defined(__SSE2__)
+		const __m128i backslash=_mm_set1_epi8('\\');
+		const __m128i control=_mm_set1_epi8(14);
+		const __m128i minusOne=_mm_set1_epi8(-1);
+
+		while(last-first>=16){
+			const __m128i v=_mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+			const __m128i special=_mm_or_si128(
+				_mm_cmpeq_epi8(v, backslash),
+				_mm_and_si128(_mm_cmplt_epi8(v, control), _mm_cmpgt_epi8(v, minusOne))
+			);
+			uint32_t mask=_mm_movemask_epi8(special);
+			if(mask){
+				return first+__builtin_ctz(mask);
+			}
+			first+=16;
+		}
+	#endif
+
+	for(; first<last; first++){
+		if(*first=='\\' || (*first>=0 && *first<14)){
+			break;
+		}
+	}
+	return first;
+}
+
+//--------------------------------------------------------------------
+
+namespace
+{
+	/*
+	 * Calls cbk(position, masks) for the blocks of [first, last) until
+	 * it returns false. The last block is padded with spaces.
+	 * */
+	template<typename FUNC>
+	inline void scanBlocks(const char* buffer, size_t first, size_t last, FUNC cbk)
+	{
+		BlockMasks masks;
+		for(size_t position=first; position<last; position+=64){
+			if(position+64<=last){
+				classify(buffer+position, masks);
+			}
+			else{
+				char tail[64];
+				std::memset(tail, ' ', 64);
+				std::memcpy(tail, buffer+position, last-position);
+				classify(tail, masks);
+			}
+
+			if(!cbk(position, masks)){
+				return;
+			}
+		}
+	}
+
+	// 1 if the byte at first is escaped by the backslashes before it
+	inline uint64_t escapedAt(const char* buffer, size_t first)
+	{
+		size_t k=first;
+		while(k>0 && buffer[k-1]=='\\'){
+			k--;
+		}
+		return (first-k) & 1;
+	}
+}
+
+//--------------------------------------------------------------------
+
+RangeSummary internal::summarizeRange(const char* buffer, size_t first, size_t last)
+{
+	RangeSummary summary;
+
+	uint64_t prevEscaped=escapedAt(buffer, first);
+	uint64_t prevInString=0;
+	uint64_t quotes=0;
+
+	scanBlocks(buffer, first, last, [&](size_t, const BlockMasks& masks){
+		uint64_t escaped=findEscaped(masks.m_backslash, prevEscaped);
+		uint64_t quote=masks.m_quote & ~escaped;
+
+		uint64_t inString=prefixXor(quote) ^ prevInString;
+		prevInString=uint64_t(int64_t(inString)>>63);
+		quotes+=__builtin_popcountll(quote);
+
+		// brackets are never quotes, so inside for one case is outside for the other
+		summary.m_depth[0]+=__builtin_popcountll(masks.m_open & ~inString)-__builtin_popcountll(masks.m_close & ~inString);
+		summary.m_depth[1]+=__builtin_popcountll(masks.m_open & inString)-__builtin_popcountll(masks.m_close & inString);
+		return true;
+	});
+
+	summary.m_oddQuotes=quotes & 1;
+
+	return summary;
+}
+
+//--------------------------------------------------------------------
+
+size_t internal::findSeparator(const char* buffer, size_t first, size_t last, bool inString, int64_t depth)
+{
+	size_t separator=last;
+
+	uint64_t prevEscaped=escapedAt(buffer, first);
+	uint64_t prevInString=inString? ~uint64_t(0) : 0;
+
+	scanBlocks(buffer, first, last, [&](size_t position, const BlockMasks& masks){
+		uint64_t escaped=findEscaped(masks.m_backslash, prevEscaped);
+		uint64_t quote=masks.m_quote & ~escaped;
+
+		uint64_t inString=prefixXor(quote) ^ prevInString;
+		prevInString=uint64_t(int64_t(inString)>>63);
+
+		uint64_t operators=masks.m_operator & ~inString;
+		while(operators){
+			size_t i=position+__builtin_ctzll(operators);
+			if(masks.m_open & (operators & -operators)){
+				depth++;
+			}
+			else if(masks.m_close & (operators & -operators)){
+				depth--;
+			}
+			else if(depth==1 && buffer[i]==','){
+				separator=i;
+				return false;
+			}
+			operators&=operators-1;
+		}
+		return true;
+	});
+
+	return separator;
+}
+
+//====================================================================
+}
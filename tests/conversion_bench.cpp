@@ -0,0 +1,156 @@
+#include "easyjson/easyjson.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+
+using namespace easyjson;
+
+//====================================================================
+
+/*
+ * FromString/ToString as they were before std::from_chars and
+ * std::to_chars, for comparison.
+ * */
+struct Legacy
+{
+	static double toDouble(const char* str)
+	{
+		return std::atof(str);
+	}
+
+	static int toInt(const char* str)
+	{
+		return std::atoi(str);
+	}
+
+	static std::string fromDouble(double t)
+	{
+		return std::to_string(t);
+	}
+};
+
+//====================================================================
+
+// every number in the file, as the parser leaves it in the buffer
+std::vector<std::string> loadNumbers(const std::string& fileName)
+{
+	std::ifstream file(fileName, std::ifstream::in);
+	std::stringstream stream;
+	stream<<file.rdbuf();
+	const std::string data=stream.str();
+
+	std::vector<std::string> numbers;
+	bool inString=false;
+	for(size_t i=0; i<data.length(); i++){
+		if(inString){
+			if(data[i]=='\\'){
+				i++;
+			}
+			else if(data[i]=='"'){
+				inString=false;
+			}
+		}
+		else if(data[i]=='"'){
+			inString=true;
+		}
+		else if(data[i]=='-' || (data[i]>47 && data[i]<58)){
+			size_t first=i;
+			while(i<data.length() && std::strchr("0123456789+-.eE", data[i]) && data[i]!=0){
+				i++;
+			}
+			numbers.emplace_back(data, first, i-first);
+			i--;
+		}
+	}
+
+	return numbers;
+}
+
+//--------------------------------------------------------------------
+
+template<typename FUNC>
+double measure(int iterations, FUNC cbk)
+{
+	auto start=std::chrono::steady_clock::now();
+	for(int i=0; i<iterations; i++){
+		cbk();
+	}
+	std::chrono::duration<double, std::micro> elapsed=std::chrono::steady_clock::now()-start;
+	return elapsed.count()/iterations;
+}
+
+//====================================================================
+
+int main(int argc, char* argv[])
+{
+	int iterations=20;
+	if(argc>1){
+		iterations=std::atoi(argv[1]);
+	}
+
+	const char* files[]={"/mesh.json", "/mesh.pretty.json", "/instruments.json", "/twitter.json"};
+
+	for(const char* fileName : files){
+		std::vector<std::string> numbers=loadNumbers(std::string(TEST_DATA_PATH)+fileName);
+
+		std::vector<double> values;
+		values.reserve(numbers.size());
+		for(const std::string& number : numbers){
+			values.push_back(FromString<double>::getFrom(number.c_str()));
+		}
+
+		// the sums keep the loops from being optimized away
+		double sum=0;
+		int64_t total=0;
+		size_t length=0;
+
+		double legacyDouble=measure(iterations, [&](){
+			for(const std::string& number : numbers){
+				sum+=Legacy::toDouble(number.c_str());
+			}
+		});
+
+		double fromCharsDouble=measure(iterations, [&](){
+			for(const std::string& number : numbers){
+				sum+=FromString<double>::getFrom(number.c_str());
+			}
+		});
+
+		double legacyInt=measure(iterations, [&](){
+			for(const std::string& number : numbers){
+				total+=Legacy::toInt(number.c_str());
+			}
+		});
+
+		double fromCharsInt=measure(iterations, [&](){
+			for(const std::string& number : numbers){
+				total+=FromString<int>::getFrom(number.c_str());
+			}
+		});
+
+		double legacyStr=measure(iterations, [&](){
+			for(double value : values){
+				length+=Legacy::fromDouble(value).length();
+			}
+		});
+
+		double toCharsStr=measure(iterations, [&](){
+			for(double value : values){
+				length+=ToString<double>::toStr(value).length();
+			}
+		});
+
+		std::cout<<"File: "<<fileName<<" ("<<numbers.size()<<" numbers)"<<std::endl;
+		std::cout<<"  FromString<double>  atof: "<<legacyDouble<<" us, from_chars: "<<fromCharsDouble<<" us"<<std::endl;
+		std::cout<<"  FromString<int>     atoi: "<<legacyInt<<" us, from_chars: "<<fromCharsInt<<" us"<<std::endl;
+		std::cout<<"  ToString<double>    to_string: "<<legacyStr<<" us, to_chars: "<<toCharsStr<<" us"<<std::endl;
+		std::cout<<"  ("<<sum<<", "<<total<<", "<<length<<")"<<std::endl;
+	}
+
+	return 0;
+}
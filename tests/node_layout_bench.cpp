@@ -0,0 +1,115 @@
+#include "easyjson/easyjson.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdlib>
+
+using namespace easyjson;
+
+/*
+ * Parse, serialization and key lookup times with the memory taken by
+ * the documents of the test data, to compare a library built with
+ * COMPACT_NODES (16 byte nodes) against the default one (32 bytes).
+ * */
+
+//====================================================================
+
+std::string loadFile(const std::string& fileName)
+{
+	std::ifstream file(fileName, std::ifstream::in);
+	std::stringstream stream;
+	stream<<file.rdbuf();
+	return stream.str();
+}
+
+//--------------------------------------------------------------------
+
+// bytes of the blocks in use in the pools of the calling thread
+size_t pooledBytes()
+{
+	size_t bytes=0;
+	for(const JsonPoolStats& stats : JsonMemory::poolStats()){
+		bytes+=stats.m_liveBlocks*stats.m_blockSize;
+	}
+	return bytes;
+}
+
+//--------------------------------------------------------------------
+
+template<typename FUNC>
+double measure(int iterations, FUNC cbk)
+{
+	auto start=std::chrono::steady_clock::now();
+	for(int i=0; i<iterations; i++){
+		cbk();
+	}
+	std::chrono::duration<double, std::micro> elapsed=std::chrono::steady_clock::now()-start;
+	return elapsed.count()/iterations;
+}
+
+//====================================================================
+
+int main(int argc, char* argv[])
+{
+	int iterations=20;
+	if(argc>1){
+		iterations=std::atoi(argv[1]);
+	}
+
+	const char* files[]={"/apache_builds.json", "/github_events.json", "/instruments.json", "/mesh.json", "/twitter.json", "/update-center.json"};
+
+	size_t length=0;
+
+	for(const char* fileName : files){
+		const std::string data=loadFile(std::string(TEST_DATA_PATH)+fileName);
+
+		double parse=measure(iterations, [&](){
+			JsonObj jsonObj=JsonObj::parse(data);
+			length+=jsonObj.isValid();
+		});
+
+		size_t before=pooledBytes();
+		JsonObj jsonObj=JsonObj::parse(data);
+		size_t pooled=pooledBytes()-before;
+		JsonDocumentStats stats=jsonObj.memoryStats();
+
+		double serialize=measure(iterations, [&](){
+			length+=jsonObj.toString().length();
+		});
+
+		std::cout<<"File: "<<fileName<<" ("<<data.length()<<" bytes)"<<std::endl;
+		std::cout<<"  nodes: "<<stats.m_nodes<<", pooled: "<<pooled<<" bytes"<<std::endl;
+		std::cout<<"  parse: "<<parse<<" us, toString: "<<serialize<<" us"<<std::endl;
+	}
+
+	// one object of many keys, for the walks down its AVL tree
+	const int keyCount=100000;
+	std::string data="{";
+	for(int i=0; i<keyCount; i++){
+		data+=(i>0? ",\"key" : "\"key")+std::to_string(i)+"\":"+std::to_string(i);
+	}
+	data+="}";
+
+	JsonObj jsonObj=JsonObj::parse(data);
+	std::vector<std::string> keys;
+	for(int i=0; i<keyCount; i++){
+		keys.push_back("key"+std::to_string((i*7919)%keyCount));
+	}
+
+	size_t found=0;
+	double lookup=measure(iterations, [&](){
+		for(const std::string& key : keys){
+			found+=jsonObj.hasKey(key.c_str());
+		}
+	});
+
+	std::cout<<"Object of "<<keyCount<<" keys"<<std::endl;
+	std::cout<<"  hasKey: "<<lookup*1000/keyCount<<" ns"<<std::endl;
+	std::cout<<"  ("<<length<<", "<<found<<")"<<std::endl;
+
+	return 0;
+}
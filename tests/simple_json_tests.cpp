@@ -1,7 +1,9 @@
 #include <functional>
 #include <fstream>
+#include <filesystem>
 
 #include "easyjson/easyjson.h"
+#include "easyjson/easyjson_sax.h"
 
 #include "utilities/profiler.h"
 Profiler<std::chrono::microseconds> profiler;
@@ -96,6 +98,31 @@ struct TestData
 
 //====================================================================
 
+// writes the events back as (compact) json
+struct SaxWriter : JsonSaxHandler
+{
+	std::string m_str;
+
+	void separator()
+	{
+		if(!m_str.empty() && m_str.back()!='{' && m_str.back()!='[' && m_str.back()!=':'){
+			m_str+=',';
+		}
+	}
+
+	void startObject(){ separator(); m_str+='{'; }
+	void endObject(){ m_str+='}'; }
+	void startArray(){ separator(); m_str+='['; }
+	void endArray(){ m_str+=']'; }
+	void key(std::string_view key){ separator(); m_str+='"'; m_str.append(key); m_str+="\":"; }
+	void string(std::string_view str){ separator(); m_str+='"'; m_str.append(str); m_str+='"'; }
+	void number(std::string_view num){ separator(); m_str.append(num); }
+	void boolean(bool val){ separator(); m_str+=val? "true" : "false"; }
+	void null(){ separator(); m_str+="null"; }
+};
+
+//====================================================================
+
 int main(int argc, char* argv[])
 {	
 	std::ios_base::sync_with_stdio(false);
@@ -1365,7 +1392,548 @@ int main(int argc, char* argv[])
 		dbg(obj.toString(true));
 	}
 
+	if(testNum==-1 || testNum==34)
+	{
+		dbgW("\n Test: 34 ===========================================");
+		
+		// escape sequences after an escaped quote must survive the compaction
+		const char* data="{\"a\": \"\\\"b\\\" \\\\ \\/ \\n \\u00e9 \\\"c\\\"\"}";
+		dbg("Test: ", data);
+
+		// decoded when parsing, only what has to be is escaped back
+		auto obj=JsonObj::parse(data);
+		checkResult(obj.toString(), "{\"a\": \"\\\"b\\\" \\\\ / \\n \u00e9 \\\"c\\\"\"}");
+		checkResult(*obj["a"].getValue<std::string>(), "\"b\" \\ / \n \u00e9 \"c\"");
+	}
+
+	if(testNum==-1 || testNum==35)
+	{
+		dbgW("\n Test: 35 ===========================================");
+
+		// the view is not NUL terminated, the parser must stop at its size
+		std::string data="{\"a\": [1, 2, \"x\"]}{\"b\": 3}";
+		std::string_view view(data.data(), 18);
+		dbg("Test: ", view);
+
+		auto obj=JsonObj::parse(view);
+		checkResult(obj.toString(), "{\"a\": [1, 2, \"x\"]}");
+	}
+
+	if(testNum==-1 || testNum==36)
+	{
+		dbgW("\n Test: 36 ===========================================");
+
+		// parsed in the caller's buffer, the edit makes the document copy it
+		const char* data="{\"a\": [1, 2, \"x\"], \"b\": null}";
+		std::string buffer(data);
+		dbg("Test: ", data);
+
+		auto obj=JsonObj::parseInSitu(buffer.data(), buffer.size());
+		checkResult(obj.toString(), data);
+
+		obj["c"]="some text";
+		checkResult(obj.toString(), "{\"a\": [1, 2, \"x\"], \"b\": null, \"c\": \"some text\"}");
+	}
+
+	if(testNum==-1 || testNum==37)
+	{
+		dbgW("\n Test: 37 ===========================================");
+
+		// chunks cut strings, escapes and numbers at arbitrary places
+		const char* data="{\"a\": [12345, -0.5e3, \"x\\\"y\"], \"bcd\": {\"e\": true}}";
+		dbg("Test: ", data);
+
+		JsonStreamParser streamParser;
+		const size_t length=std::strlen(data);
+		for(size_t i=0; i<length; i+=3){
+			streamParser.feed(data+i, std::min<size_t>(3, length-i));
+		}
+
+		auto obj=streamParser.finish();
+		checkResult(obj.toString(), data);
+	}
+
+	if(testNum==-1 || testNum==38)
+	{
+		dbgW("\n Test: 38 ===========================================");
+
+		// the empty line is skipped but counted, the '\r' is dropped
+		JsonLinesReader reader(TEST_DATA_PATH "/test_lines.jsonl");
+		std::string lines;
+		while(reader.next()){
+			lines+=std::to_string(reader.lineNumber())+" "+reader.document().toString()+"\n";
+		}
+		dbg("Test: ", lines);
+
+		checkResult(lines, "1 {\"a\": 1, \"b\": [true, null]}\n3 {\"c\": \"x\\\"y\"}\n4 [1, 2, {\"d\": {}}]\n");
+	}
+
+	if(testNum==-1 || testNum==39)
+	{
+		dbgW("\n Test: 39 ===========================================");
+
+		// events in document order, strings as written
+		const char* data="{\"a\": [1, -0.5e3, \"x\\\"y\", true, null], \"b\": {\"c\": {}, \"d\": []}}";
+		dbg("Test: ", data);
+
+		JsonSax sax;
+		SaxWriter writer;
+		sax.parse(data, std::strlen(data), writer);
+		checkResult(writer.m_str, "{\"a\":[1,-0.5e3,\"x\\\"y\",true,null],\"b\":{\"c\":{},\"d\":[]}}");
+
+		JsonSax quietSax(ErrorHandlerMode::Quiet);
+		JsonSaxHandler handler;
+		quietSax.parse(std::string_view("{\"a\": [1, 2}"), handler);
+		checkResult(quietSax.getErrorMsg(), "Expecting ']' got '}'");
+	}
+
+	if(testNum==-1 || testNum==40)
+	{
+		dbgW("\n Test: 40 ===========================================");
+
+		// the same key in nested objects is fine, not in the same one
+		const char* data="{\"a\": {\"a\": 1, \"b\": [{\"a\": 2}]}, \"b\": 3, \"a\": 4}";
+		dbg("Test: ", data);
+
+		auto result=JsonObj::validate(data);
+		checkResult(result.getErrorMsg(), "Error: Duplicate key.");
+		checkResult(std::to_string(result.m_position), "41"); // the quote of the second "a"
+
+		result=JsonObj::validate(data, false);
+		checkResult(result.getErrorMsg(), "JSON is valid");
+	}
+
+	if(testNum==-1 || testNum==41)
+	{
+		dbgW("\n Test: 41 ===========================================");
+
+		const char* data="{\"a\": {\"b\": [1, {\"c\": \"x\\\"y\"}], \"d\": true}, \"e\": [ 2,3 ]}";
+		dbg("Test: ", data);
+
+		JsonObj jsonObj=JsonObj::parseLazy(data, std::strlen(data));
+		checkResult(jsonObj.toString(), "{\"a\": {\"b\": [1, {\"c\": \"x\\\"y\"}], \"d\": true}, \"e\": [ 2,3 ]}");
+
+		// only "a" is parsed, "b" is still copied as it was written
+		checkResult(jsonObj["a"]["d"].toString(), "true");
+		checkResult(jsonObj.toString(), "{\"a\": {\"b\": [1, {\"c\": \"x\\\"y\"}], \"d\": true}, \"e\": [ 2,3 ]}");
+
+		checkResult(jsonObj.follow("a/b/1/c").toString(), "\"x\\\"y\"");
+		jsonObj["e"].pushBack(4);
+		checkResult(jsonObj.toString(), "{\"a\": {\"b\": [1, {\"c\": \"x\\\"y\"}], \"d\": true}, \"e\": [2, 3, 4]}");
+
+		// checked as a whole, as parse would do it
+		JsonObj badObj=JsonObj::parseLazy("{\"a\": {\"b\": 1, \"b\": 2}}", ErrorHandlerMode::Quiet);
+		checkResult(badObj.getErrorMsg(), "Error: Duplicate key.");
+	}
+
+	if(testNum==-1 || testNum==42)
+	{
+		dbgW("\n Test: 42 ===========================================");
+
+		// large enough to be split, the strings hold ',', '[' and '"'
+		std::string data="[";
+		for(int i=0; i<100000; i++){
+			data+="{\"id\": "+std::to_string(i)+", \"s\": \"a, [\\\"b\\\"]\", \"v\": [1, {\"c\": null}]},";
+		}
+		data+="[]]";
+
+		JsonObj serialObj=JsonObj::parse(data.c_str(), data.size());
+		JsonObj jsonObj=JsonObj::parse(data.c_str(), data.size(), 4);
+		checkResult(std::to_string(jsonObj.size()), "100001");
+		checkResult(jsonObj.toString()==serialObj.toString()? "same document" : "different", "same document");
+		checkResult(jsonObj[70000]["id"].toString(), "70000");
+
+		// the same error as parse, wherever the range it is found in
+		data[data.find("\"id\":", data.size()*5/8)+4]=',';
+		JsonObj serialBad=JsonObj::parse(data.c_str(), data.size(), ErrorHandlerMode::Quiet);
+		JsonObj badObj=JsonObj::parse(data.c_str(), data.size(), 4, ErrorHandlerMode::Quiet);
+		checkResult(badObj.getErrorMsg(), serialBad.getErrorMsg().c_str());
+	}
+
+	if(testNum==-1 || testNum==43)
+	{
+		dbgW("\n Test: 43 ===========================================");
+
+		std::vector<std::string_view> data;
+		for(int i=0; i<200; i++){
+			data.push_back(i%50==7? "{\"a\": [1, }" : "{\"a\": [1, {\"b\": null}], \"c\": \"x\"}");
+		}
+
+		// the invalid documents do not throw, they keep their error
+		JsonDocuments documents=JsonObj::parseMany(data, 4);
+		checkResult(std::to_string(documents.size()), "200");
+		checkResult(std::to_string(documents.errorCount()), "4");
+		checkResult(documents[57].getErrorMsg(), "Expecting 'string', '}', got 'undefined'");
+		checkResult(documents[199].toString(), "{\"a\": [1, {\"b\": null}], \"c\": \"x\"}");
+	}
+
+	if(testNum==-1 || testNum==44)
+	{
+		dbgW("\n Test: 44 ===========================================");
+
+		const char* data="{\"meta\": {\"count\": 2, \"next\": \"x\"}, \"items\": [{\"id\": 1, \"user\": {\"name\": \"a\", \"tags\": [1, 2]}}, {\"id\": 2, \"user\": {\"name\": \"b\"}, \"skip\": [\"}\", {\"q\": \"]\"}]}]}";
+		dbg("Test: ", data);
+
+		JsonObj jsonObj=JsonObj::parseProjected(data, {"meta/count", "items/*/user/name", "items/0/id"});
+		checkResult(jsonObj.toString(), "{\"items\": [{\"id\": 1, \"user\": {\"name\": \"a\"}}, {\"user\": {\"name\": \"b\"}}], \"meta\": {\"count\": 2}}");
+		checkResult(jsonObj.follow("items/1/user/name").toString(), "\"b\"");
+
+		// items left out are dropped
+		JsonObj secondObj=JsonObj::parseProjected(data, {"items/1/id"});
+		checkResult(secondObj.toString(), "{\"items\": [{\"id\": 2}]}");
+	}
+
+	if(testNum==-1 || testNum==45)
+	{
+		dbgW("\n Test: 45 ===========================================");
+
+		const char* data="{\"big\": 9007199254740993, \"small\": -42, \"real\": 0.1, \"exp\": 1e3, \"huge\": 1e400, \"list\": [7, 2.5]}";
+		dbg("Test: ", data);
+
+		JsonObj jsonObj=JsonObj::parse(data, ParseOptions{.m_decodeNumbers=true});
+		checkResult(jsonObj.toString(), "{\"big\": 9007199254740993, \"exp\": 1e3, \"huge\": 1e400, \"list\": [7, 2.5], \"real\": 0.1, \"small\": -42}");
+
+		// exact, where a double would round it
+		checkResult(std::to_string(*jsonObj["big"].getValue<long long>()), "9007199254740993");
+		checkResult(std::to_string(*jsonObj["small"].getValue<int>()), "-42");
+		checkResult(std::to_string(*jsonObj["exp"].getValue<long>()), "1000");
+		checkResult(*jsonObj["real"].getValue<double>()==0.1? "same value" : "different value", "same value");
+		checkResult(std::to_string(*jsonObj["list"][1].getValue<double>()), "2.500000");
+
+		// out of range, left as text
+		checkResult(*jsonObj["huge"].getValue<std::string>(), "1e400");
+
+		// the decoded number goes away with the value
+		jsonObj["small"]={1, 2};
+		checkResult(jsonObj["small"].toString(), "[1, 2]");
+	}
+
+	if(testNum==-1 || testNum==46)
+	{
+		dbgW("\n Test: 46 ===========================================");
+
+		auto obj=JsonObj::initObj();
+		obj["a"]=0.1;
+		obj["b"]=123.456f;
+		obj["c"]=1e300;
+		obj["d"]=-7;
+		checkResult(obj.toString(), "{\"a\": 0.1, \"b\": 123.456, \"c\": 1e+300, \"d\": -7}");
+
+		JsonObj jsonObj=JsonObj::parse("[3000000000, -2.9, 1.5e3, 1e400]");
+		checkResult(std::to_string(*jsonObj[0].getValue<int>()), "2147483647");
+		checkResult(std::to_string(*jsonObj[1].getValue<int>()), "-2");
+		checkResult(std::to_string(*jsonObj[2].getValue<int>()), "1500");
+		checkResult(std::to_string(*jsonObj[3].getValue<double>()), "inf");
+	}
+
+	if(testNum==-1 || testNum==47)
+	{
+		dbgW("\n Test: 47 ===========================================");
+
+		ParseOptions options;
+		options.m_strictUTF8=true;
+
+		JsonObj jsonObj=JsonObj::parse("{\"a\": \"caf\xC3\xA9 \xF0\x9F\x98\x80\"}", options, ErrorHandlerMode::Quiet);
+		checkResult(jsonObj.getErrorMsg(), "JSON is valid");
+
+		// a lone surrogate
+		JsonObj jsonObj2=JsonObj::parse("{\"a\": \"caf\xC3\xA9\", \"b\": \"\xED\xA0\x80\"}", options, ErrorHandlerMode::Quiet);
+		checkResult(jsonObj2.getErrorMsg(), "Invalid UTF-8 sequence");
+		checkResult(std::to_string(jsonObj2.getErrorPosition()), "21");
+
+		// not checked unless asked for
+		JsonObj jsonObj3=JsonObj::parse("[\"\xC0\xAF\"]", ErrorHandlerMode::Quiet);
+		checkResult(jsonObj3.getErrorMsg(), "JSON is valid");
+	}
+
+	if(testNum==-1 || testNum==48)
+	{
+		dbgW("\n Test: 48 ===========================================");
+
+		JsonReusableParser parser(ParseOptions(), ErrorHandlerMode::Quiet);
+
+		JsonObj& jsonObj=parser.parse("{\"a\": [1, 2, {\"b\": null}], \"c\": \"d\"}");
+		checkResult(jsonObj.toString(), "{\"a\": [1, 2, {\"b\": null}], \"c\": \"d\"}");
+
+		parser.parse("{\"a\": [1, ");
+		checkResult(parser.document().getErrorMsg(), "Expecting 'string', '}', got 'undefined'");
+
+		// the same document, the error is gone
+		parser.parse("[true, \"x\"]");
+		checkResult(jsonObj.toString(), "[true, \"x\"]");
+	}
+
+	//-----------------------------------------------------------------
+
+	if(testNum==-1 || testNum==49)
+	{
+		dbgW("\n Test: 49 ===========================================");
+
+		ParseOptions options;
+		options.m_internKeys=true;
+
+		JsonObj jsonObj=JsonObj::parse("[{\"name\": 1, \"id\": 2}, {\"id\": 3, \"name\": 4, \"age\": 5}]", options);
+		checkResult(jsonObj.toString(), "[{\"id\": 2, \"name\": 1}, {\"age\": 5, \"id\": 3, \"name\": 4}]");
+		checkResult(std::to_string(jsonObj[1].hasKey("name")), "1");
+		checkResult(std::to_string(jsonObj[0].hasKey("age")), "0");
+		checkResult(std::to_string(jsonObj[1].hasKey("missing")), "0");
+
+		jsonObj[0]["age"]=6;
+		checkResult(jsonObj[0].toString(), "{\"age\": 6, \"id\": 2, \"name\": 1}");
+
+		JsonObj jsonObj2=JsonObj::parse("{\"a\": 1, \"b\": 2, \"a\": 3}", options, ErrorHandlerMode::Quiet);
+		checkResult(jsonObj2.getErrorMsg(), "Error: Duplicate key.");
+	}
+
+	//-----------------------------------------------------------------
+
+	if(testNum==-1 || testNum==50)
+	{
+		dbgW("\n Test: 50 ===========================================");
+
+		ParseOptions options;
+		options.m_trustedInput=true;
+
+		JsonObj jsonObj=JsonObj::parse("{\"b\": 1, \"a\": {\"c\": 2, \"a\": 3}, \"b\": 4}", options);
+		checkResult(jsonObj.toString(), "{\"b\": 1, \"a\": {\"c\": 2, \"a\": 3}, \"b\": 4}");
+
+		// the last duplicate wins once the object is indexed
+		checkResult(jsonObj["b"].toString(), "4");
+		checkResult(jsonObj.toString(), "{\"a\": {\"c\": 2, \"a\": 3}, \"b\": 4}");
+	}
+
+	//-----------------------------------------------------------------
+
+	if(testNum==-1 || testNum==51)
+	{
+		dbgW("\n Test: 51 ===========================================");
+
+		ParseOptions options;
+		options.m_arena=true;
+
+		JsonObj jsonObj=JsonObj::parse("{\"a\": [1, 2, {\"b\": null}], \"c\": \"d\"}", options);
+		checkResult(jsonObj.toString(), "{\"a\": [1, 2, {\"b\": null}], \"c\": \"d\"}");
+
+		// edits take and give back nodes of the same arena
+		jsonObj["a"].pushBack(3);
+		jsonObj["e"]={{"f", 1}, {"g", 2}};
+		jsonObj.removeKey("c");
+		checkResult(jsonObj.toString(), "{\"a\": [1, 2, {\"b\": null}, 3], \"e\": [{\"f\": 1}, {\"g\": 2}]}");
+	}
+
+	if(testNum==-1 || testNum==52)
+	{
+		dbgW("\n Test: 52 ===========================================");
+
+		JsonObj kept=JsonObj::parse("{\"a\": [1, 2, {\"b\": null}]}");
+		{
+			JsonObj jsonObj=JsonObj::parse("[]");
+			for(int i=0; i<100000; i++){
+				jsonObj.pushBack(i);
+			}
+		}
+
+		// the blocks of the array are free, the ones of kept are not
+		checkResult(std::to_string(JsonMemory::trim()>0), "1");
+		checkResult(kept.toString(), "{\"a\": [1, 2, {\"b\": null}]}");
+
+		JsonMemory::setHighWatermark(1<<20);
+		{
+			JsonObj jsonObj=JsonObj::parse("[]");
+			for(int i=0; i<100000; i++){
+				jsonObj.pushBack(i);
+			}
+		}
+		JsonMemory::setHighWatermark(0);
+
+		// already trimmed when jsonObj was released
+		checkResult(std::to_string(JsonMemory::trim()), "0");
+	}
+
+	if(testNum==-1 || testNum==53)
+	{
+		dbgW("\n Test: 53 ===========================================");
+
+		auto liveBlocks=[](){
+			size_t blocks=0;
+			for(const JsonPoolStats& stats : JsonMemory::poolStats()){
+				blocks+=stats.m_liveBlocks;
+			}
+			return blocks;
+		};
+		size_t liveBefore=liveBlocks();
+
+		JsonObj jsonObj=JsonObj::parse("{\"a\": [1, 2, {\"b\": null}], \"c\": \"d\"}");
+		JsonDocumentStats stats=jsonObj.memoryStats();
+		checkResult(std::to_string(stats.m_nodes)+" "+std::to_string(stats.m_vectors), "10 1");
+
+		// the nodes, the vector of the array and its items, whatever the node layout
+		size_t liveAfter=liveBlocks();
+		checkResult(std::to_string(liveAfter-liveBefore), "12");
+
+		stats=jsonObj["a"].memoryStats();
+		checkResult(std::to_string(stats.m_nodes)+" "+std::to_string(stats.m_vectors), "6 1");
+	}
+
+	if(testNum==-1 || testNum==54)
+	{
+		dbgW("\n Test: 54 ===========================================");
+
+		// rejected before anything is read, the buffer does not need to be that long
+		char buffer[]="[1, 2]";
+		const size_t tooLong=size_t(1)<<31;
+
+		JsonObj jsonObj=JsonObj::parseInSitu(buffer, tooLong, ErrorHandlerMode::Quiet);
+		checkResult(jsonObj.getErrorMsg(), "JSON too large: the limit is 2GiB");
 
+		auto result=JsonObj::validate(std::string_view(buffer, tooLong));
+		checkResult(result.getErrorMsg(), "JSON too large: the limit is 2GiB");
+
+		JsonObj valid=JsonObj::parseInSitu(buffer, std::strlen(buffer), ErrorHandlerMode::Quiet);
+		checkResult(valid.toString(), "[1, 2]");
+	}
+
+	if(testNum==-1 || testNum==55)
+	{
+		dbgW("\n Test: 55 ===========================================");
+
+		// sparse, no disk space is taken, and the file is neither mapped nor read
+		std::filesystem::path fileName=std::filesystem::temp_directory_path()/"easyjson_test_55.json";
+		std::ofstream(fileName)<<"[1, 2]";
+		std::filesystem::resize_file(fileName, size_t(1)<<31);
+
+		JsonObj jsonObj=JsonObj::parseJsonFile(fileName.c_str(), ErrorHandlerMode::Quiet);
+		checkResult(jsonObj.getErrorMsg(), "JSON too large: the limit is 2GiB");
+
+		std::filesystem::remove(fileName);
+	}
+
+	if(testNum==-1 || testNum==56)
+	{
+		dbgW("\n Test: 56 ===========================================");
+
+		// lone surrogates, high and low, are written back as they were read, pairs and U+D55C are not escaped
+		const char* data="{\"a\": \"x\\ud83dy\", \"b\": \"\\uDE00\", \"c\": \"\\ud83d\\ude00 \\ud55c\"}";
+		dbg("Test: ", data);
+
+		auto obj=JsonObj::parse(data);
+		const std::string expected="{\"a\": \"x\\ud83dy\", \"b\": \"\\ude00\", \"c\": \"\U0001F600 \uD55C\"}";
+		checkResult(obj.toString(), expected.c_str());
+		checkResult(*obj["b"].getValue<std::string>(), "\xED\xB8\x80");
+
+		auto again=JsonObj::parse(obj.toString());
+		checkResult(again.toString(), expected.c_str());
+	}
+
+	if(testNum==-1 || testNum==57)
+	{
+		dbgW("\n Test: 57 ===========================================");
+
+		// U+0000 is stored as C0 80 but a std::string gets '\0'
+		const char* data="{\"k\\u0000\": \"a\\u0000b\"}";
+		dbg("Test: ", data);
+
+		auto obj=JsonObj::parse(data);
+		checkResult(obj.toString(), "{\"k\\u0000\": \"a\\u0000b\"}");
+		checkResult(std::to_string(obj.hasKey("k\xC0\x80")), "1");
+
+		std::string value=*obj["k\xC0\x80"].getValue<std::string>();
+		checkResult(std::to_string(value.length()), "3");
+		checkResult(std::to_string(int(value[1])), "0");
+
+		checkResult(std::to_string(JsonObj::utf8Encode("x\\u0000y").length()), "3");
+	}
+
+	if(testNum==-1 || testNum==58)
+	{
+		dbgW("\n Test: 58 ===========================================");
+
+		// RFC 8259 only has \u, \U is not an escape sequence
+		const char* data="{\"a\": \"\\U00e9\"}";
+		dbg("Test: ", data);
+
+		JsonObj obj=JsonObj::parse(data, ErrorHandlerMode::Quiet);
+		checkResult(std::to_string(obj.isValid()), "0");
+		checkResult(std::to_string(JsonObj::validate(data).isValid()), "0");
+	}
+
+	if(testNum==-1 || testNum==59)
+	{
+		dbgW("\n Test: 59 ===========================================");
+
+		// keys are duplicates once decoded, whatever parses them
+		const char* docs[]={"{\"a\\/b\":1,\"a/b\":2}", "{\"\\u0061\":1,\"a\":2}", "{\"x\":[{\"a\\/b\":1, \"a/b\":2}]}"};
+		for(const char* data : docs){
+			dbg("Test: ", data);
+
+			JsonObj obj=JsonObj::parse(data, ErrorHandlerMode::Quiet);
+			checkResult(obj.getErrorMsg(), "Error: Duplicate key.");
+
+			checkResult(JsonObj::validate(data).getErrorMsg(), "Error: Duplicate key.");
+
+			JsonObj lazyObj=JsonObj::parseLazy(data, ErrorHandlerMode::Quiet);
+			checkResult(lazyObj.getErrorMsg(), "Error: Duplicate key.");
+
+			JsonSax sax(ErrorHandlerMode::Quiet);
+			JsonSaxHandler handler;
+			sax.parse(data, std::strlen(data), handler);
+			checkResult(sax.getErrorMsg(), "Error: Duplicate key.");
+
+			sax.parse(data, std::strlen(data), handler, false);
+			checkResult(sax.getErrorMsg(), "JSON is valid");
+		}
+	}
+
+	if(testNum==-1 || testNum==60)
+	{
+		dbgW("\n Test: 60 ===========================================");
+
+		// truncated input, parseInSitu reports what parse reports
+		const char* docs[][2]={
+			{"{\"a\":1", "Expecting 'string', '}', got 'undefined'"},
+			{"{\"a\":{\"b\":true", "Expecting 'string', 'number', 'null', 'true', 'false', '{', '[', got 'undefined'"},
+			{"[1, -1.5e", "Expecting 'number'"},
+			{"{\"a\":\"x", "Expecting 'string', '}', got 'undefined'"}
+		};
+		for(const auto& doc : docs){
+			dbg("Test: ", doc[0]);
+
+			JsonObj obj=JsonObj::parse(doc[0], ErrorHandlerMode::Quiet);
+			checkResult(obj.getErrorMsg(), doc[1]);
+
+			std::string buffer=doc[0];
+			JsonObj inSitu=JsonObj::parseInSitu(buffer.data(), buffer.size(), ErrorHandlerMode::Quiet);
+			checkResult(inSitu.getErrorMsg(), doc[1]);
+		}
+	}
+
+	if(testNum==-1 || testNum==61)
+	{
+		dbgW("\n Test: 61 ===========================================");
+
+		// error positions, as JsonObj::validate gives them
+		const char* docs[][2]={
+			{"{\"a\": 1, \"a\": 2}", "9"},
+			{"[1, 2  ", "5"},
+			{"{\"a\": tru}", "6"},
+			{"[1, 2] 3", "7"}
+		};
+		for(const auto& doc : docs){
+			dbg("Test: ", doc[0]);
+
+			JsonObj obj=JsonObj::parse(doc[0], ErrorHandlerMode::Quiet);
+			checkResult(std::to_string(obj.getErrorPosition()), doc[1]);
+			checkResult(std::to_string(JsonObj::validate(doc[0]).m_position), doc[1]);
+
+			JsonStreamParser streamParser(ErrorHandlerMode::Quiet);
+			streamParser.feed(doc[0], 3);
+			streamParser.feed(doc[0]+3);
+			JsonObj streamed=streamParser.finish();
+			checkResult(std::to_string(streamed.getErrorPosition()), doc[1]);
+		}
+
+		checkResult(std::to_string(JsonObj::parse("[1, 2]").getErrorPosition()==JsonObj::npos), "1");
+	}
 
 	#endif
 